@@ -0,0 +1,348 @@
+/********************************
+
+AccessControl.h
+
+Device access control for PlaybackModuleMIDI
+
+Rules are "allow <pattern>" or "deny <pattern>", one per line, where
+<pattern> is an exact device name, a name prefix ending in a single
+trailing '*' (e.g. studio-*), or a glob using '*' and '?' anywhere.
+Lines starting with '#' are comments.
+
+If any allow rule exists, a device must match one to connect.
+A matching deny rule always wins over an allow rule.
+
+Rules are compiled into a hash set for exact names, a trie for prefixes
+and a list for the (rare) general globs. Recent verdicts are kept in a
+small direct-mapped cache, so repeated heartbeats from the same device
+cost a hash and a string compare. A compiled rule set is immutable and
+is swapped in atomically on reload, so checks never see a half-loaded
+rule set and existing connections are left untouched.
+
+********************************/
+
+#ifndef NDNMIDI_ACCESS_CONTROL_H
+#define NDNMIDI_ACCESS_CONTROL_H
+
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Number of entries in the verdict cache (power of two)
+#define ACL_CACHE_SIZE 64
+
+enum AclVerdict
+{
+	ACL_ALLOWED,
+	ACL_NOT_ALLOWED,	// allow rules exist but none matched
+	ACL_PROHIBITED		// a deny rule matched
+};
+
+struct AclRule
+{
+	bool allow;
+	std::string pattern;
+};
+
+// Immutable matcher built from a list of rules
+class CompiledAcl
+{
+public:
+	explicit CompiledAcl(const std::vector<AclRule>& rules)
+		: m_rules(rules)
+		, m_hasAllowRules(false)
+	{
+		m_trie.push_back(TrieNode());
+		for (const AclRule& rule : rules)
+		{
+			int flag = rule.allow ? MATCH_ALLOW : MATCH_DENY;
+			if (rule.allow)
+			{
+				m_hasAllowRules = true;
+			}
+
+			size_t wildcard = rule.pattern.find_first_of("*?");
+			if (wildcard == std::string::npos)
+			{
+				(rule.allow ? m_allowExact : m_denyExact).insert(rule.pattern);
+			}
+			else if (wildcard == rule.pattern.size() - 1 && rule.pattern[wildcard] == '*')
+			{
+				insertPrefix(rule.pattern.substr(0, wildcard), flag);
+			}
+			else
+			{
+				m_globs.push_back(rule);
+			}
+		}
+	}
+
+	AclVerdict
+	check(const std::string& name) const
+	{
+		size_t slot = std::hash<std::string>()(name) & (ACL_CACHE_SIZE - 1);
+		{
+			std::lock_guard<std::mutex> lock(m_cacheMutex);
+			if (m_cache[slot].valid && m_cache[slot].name == name)
+			{
+				return m_cache[slot].verdict;
+			}
+		}
+
+		AclVerdict verdict = evaluate(name);
+
+		std::lock_guard<std::mutex> lock(m_cacheMutex);
+		m_cache[slot].valid = true;
+		m_cache[slot].name = name;
+		m_cache[slot].verdict = verdict;
+		return verdict;
+	}
+
+	const std::vector<AclRule>&
+	getRules() const
+	{
+		return m_rules;
+	}
+
+private:
+	enum
+	{
+		MATCH_ALLOW = 1,
+		MATCH_DENY = 2
+	};
+
+	struct TrieNode
+	{
+		std::map<char, size_t> next;
+		int flags = 0;
+	};
+
+	struct CacheEntry
+	{
+		bool valid = false;
+		std::string name;
+		AclVerdict verdict;
+	};
+
+	void
+	insertPrefix(const std::string& prefix, int flag)
+	{
+		size_t node = 0;
+		for (char c : prefix)
+		{
+			std::map<char, size_t>::iterator it = m_trie[node].next.find(c);
+			if (it == m_trie[node].next.end())
+			{
+				m_trie.push_back(TrieNode());
+				m_trie[node].next[c] = m_trie.size() - 1;
+				node = m_trie.size() - 1;
+			}
+			else
+			{
+				node = it->second;
+			}
+		}
+		m_trie[node].flags |= flag;
+	}
+
+	// Flags of every prefix rule matching name
+	int
+	matchPrefixes(const std::string& name) const
+	{
+		size_t node = 0;
+		int flags = m_trie[0].flags;
+		for (char c : name)
+		{
+			std::map<char, size_t>::const_iterator it = m_trie[node].next.find(c);
+			if (it == m_trie[node].next.end())
+			{
+				break;
+			}
+			node = it->second;
+			flags |= m_trie[node].flags;
+		}
+		return flags;
+	}
+
+	static bool
+	globMatch(const char* pattern, const char* name)
+	{
+		const char* star = NULL;
+		const char* retry = NULL;
+		while (*name)
+		{
+			if (*pattern == '?' || *pattern == *name)
+			{
+				++pattern;
+				++name;
+			}
+			else if (*pattern == '*')
+			{
+				star = pattern++;
+				retry = name;
+			}
+			else if (star)
+			{
+				pattern = star + 1;
+				name = ++retry;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		while (*pattern == '*')
+		{
+			++pattern;
+		}
+		return *pattern == '\0';
+	}
+
+	AclVerdict
+	evaluate(const std::string& name) const
+	{
+		int flags = matchPrefixes(name);
+		if (m_allowExact.count(name) > 0)
+		{
+			flags |= MATCH_ALLOW;
+		}
+		if (m_denyExact.count(name) > 0)
+		{
+			flags |= MATCH_DENY;
+		}
+		for (const AclRule& rule : m_globs)
+		{
+			if (globMatch(rule.pattern.c_str(), name.c_str()))
+			{
+				flags |= rule.allow ? MATCH_ALLOW : MATCH_DENY;
+			}
+		}
+
+		if (flags & MATCH_DENY)
+		{
+			return ACL_PROHIBITED;
+		}
+		if (m_hasAllowRules && !(flags & MATCH_ALLOW))
+		{
+			return ACL_NOT_ALLOWED;
+		}
+		return ACL_ALLOWED;
+	}
+
+	std::vector<AclRule> m_rules;
+	bool m_hasAllowRules;
+
+	std::unordered_set<std::string> m_allowExact;
+	std::unordered_set<std::string> m_denyExact;
+	std::vector<TrieNode> m_trie;
+	std::vector<AclRule> m_globs;
+
+	mutable std::mutex m_cacheMutex;
+	mutable CacheEntry m_cache[ACL_CACHE_SIZE];
+};
+
+// Holds the active rule set and replaces it atomically
+class AccessControl
+{
+public:
+	AccessControl()
+		: m_current(std::make_shared<CompiledAcl>(std::vector<AclRule>()))
+	{
+	}
+
+	AclVerdict
+	check(const std::string& name) const
+	{
+		return std::atomic_load(&m_current)->check(name);
+	}
+
+	std::vector<AclRule>
+	getRules() const
+	{
+		return std::atomic_load(&m_current)->getRules();
+	}
+
+	// Add a single rule on top of the current rule set
+	void
+	addRule(bool allow, const std::string& pattern)
+	{
+		std::lock_guard<std::mutex> lock(m_writeMutex);
+		std::vector<AclRule> rules = std::atomic_load(&m_current)->getRules();
+		rules.push_back({allow, pattern});
+		install(rules);
+	}
+
+	// Replace the rule set with the contents of fileName
+	// The current rule set is kept if the file cannot be parsed
+	bool
+	loadFile(const std::string& fileName)
+	{
+		std::ifstream file(fileName);
+		if (!file)
+		{
+			std::cerr << "Could not open access rules: " << fileName << std::endl;
+			return false;
+		}
+
+		std::vector<AclRule> rules;
+		std::string line;
+		int lineNo = 0;
+		while (std::getline(file, line))
+		{
+			++lineNo;
+			std::istringstream words(line);
+			std::string action;
+			std::string pattern;
+			if (!(words >> action) || action[0] == '#')
+			{
+				continue;
+			}
+			if ((action != "allow" && action != "deny") || !(words >> pattern))
+			{
+				std::cerr << fileName << ":" << lineNo
+						  << ": expected \"allow <pattern>\" or \"deny <pattern>\"" << std::endl;
+				return false;
+			}
+			rules.push_back({action == "allow", pattern});
+		}
+
+		std::lock_guard<std::mutex> lock(m_writeMutex);
+		install(rules);
+		m_fileName = fileName;
+		return true;
+	}
+
+	// Reload the last file given to loadFile()
+	bool
+	reload()
+	{
+		if (m_fileName.empty())
+		{
+			std::cerr << "No access rules file to reload" << std::endl;
+			return false;
+		}
+		return loadFile(m_fileName);
+	}
+
+private:
+	void
+	install(const std::vector<AclRule>& rules)
+	{
+		std::shared_ptr<const CompiledAcl> compiled = std::make_shared<CompiledAcl>(rules);
+		std::atomic_store(&m_current, compiled);
+	}
+
+	std::shared_ptr<const CompiledAcl> m_current;
+	std::mutex m_writeMutex;
+	std::string m_fileName;
+};
+
+#endif
@@ -0,0 +1,243 @@
+/********************************
+
+BatchDecode.h
+
+Whole-packet decoding of UMP words for PlaybackModuleMIDI
+
+A batch decoder converts a packet of big-endian UMP words to host order,
+rewrites the channel of every MIDI 1.0 channel voice message and
+classifies the packet in one pass:
+
+  BATCH_SHUTDOWN   the packet contains the shutdown marker
+  BATCH_IRREGULAR  the packet contains something other than single-word
+                   system / MIDI 1.0 voice messages with valid status
+                   bytes and utility messages (e.g. MIDI 2.0 messages);
+                   the caller must walk it message by message
+
+Utility messages (JR timestamps) are passed through unchanged.
+
+The batch decoders take every word for a message head, which corrupts
+the data words of multi-word messages. An irregular packet must be
+decoded again with batchDecodeMessages(), which walks it message by
+message.
+
+SSSE3 and AVX2 versions process 4 and 8 words per step. The best version
+for the running CPU is picked once at startup, with a scalar fallback.
+
+********************************/
+
+#ifndef NDNMIDI_BATCH_DECODE_H
+#define NDNMIDI_BATCH_DECODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "UniversalMidiPacket.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+  #define NDNMIDI_BATCH_X86
+  #include <immintrin.h>
+#endif
+
+#define BATCH_SHUTDOWN 1
+#define BATCH_IRREGULAR 2
+
+typedef unsigned int (*BatchDecodeFn)(const uint8_t *in, size_t count, unsigned int channel, uint32_t *out);
+
+// Decode words [begin, count) one at a time
+inline unsigned int
+batchDecodeTail(const uint8_t *in, size_t begin, size_t count, unsigned int channel, uint32_t *out)
+{
+	unsigned int flags = 0;
+	for (size_t i = begin; i < count; ++i)
+	{
+		uint32_t word = umpRead(in + 4 * i);
+		unsigned int type = word >> 28;
+		unsigned int statusHi = (word >> 20) & 0x0F;
+		unsigned int status = (word >> 16) & 0xFF;
+
+		if (type == UMP_TYPE_MIDI1_VOICE && statusHi >= 0x8 && statusHi <= 0xE)
+		{
+			word = (word & 0xFFF0FFFFu) | ((channel & 0x0F) << 16);
+		}
+		else if (type == UMP_TYPE_SYSTEM && statusHi == 0xF && status != 0xF0 && status != 0xF7)
+		{
+		}
+		else if (word == UMP_SHUTDOWN)
+		{
+			flags |= BATCH_SHUTDOWN;
+		}
+		else if (type == UMP_TYPE_UTILITY)
+		{
+		}
+		else
+		{
+			flags |= BATCH_IRREGULAR;
+		}
+		out[i] = word;
+	}
+	return flags;
+}
+
+// Decode a packet message by message, only rewriting the channel of
+// message heads; for packets a batch decoder found irregular
+inline unsigned int
+batchDecodeMessages(const uint8_t *in, size_t count, unsigned int channel, uint32_t *out)
+{
+	unsigned int flags = BATCH_IRREGULAR;
+	for (size_t i = 0; i < count; ++i)
+	{
+		out[i] = umpRead(in + 4 * i);
+	}
+	for (size_t i = 0; i < count; i += umpWordCount(out[i]))
+	{
+		if (out[i] == UMP_SHUTDOWN)
+		{
+			flags |= BATCH_SHUTDOWN;
+		}
+		out[i] = umpSetChannel(out[i], channel);
+	}
+	return flags;
+}
+
+inline unsigned int
+batchDecodeScalar(const uint8_t *in, size_t count, unsigned int channel, uint32_t *out)
+{
+	return batchDecodeTail(in, 0, count, channel, out);
+}
+
+#ifdef NDNMIDI_BATCH_X86
+
+__attribute__((target("ssse3")))
+inline unsigned int
+batchDecodeSSSE3(const uint8_t *in, size_t count, unsigned int channel, uint32_t *out)
+{
+	const __m128i bswap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	const __m128i nibble = _mm_set1_epi32(0x0F);
+	const __m128i channelMask = _mm_set1_epi32(0xFFF0FFFF);
+	const __m128i channelBits = _mm_set1_epi32((channel & 0x0F) << 16);
+	const __m128i zero = _mm_setzero_si128();
+
+	int regularMask = 0;
+	int shutdownMask = 0;
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i word = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + 4 * i)), bswap);
+		__m128i type = _mm_srli_epi32(word, 28);
+		__m128i statusHi = _mm_and_si128(_mm_srli_epi32(word, 20), nibble);
+		__m128i status = _mm_and_si128(_mm_srli_epi32(word, 16), _mm_set1_epi32(0xFF));
+
+		// MIDI 1.0 channel voice with status 0x8n..0xEn
+		__m128i voice = _mm_and_si128(_mm_cmpeq_epi32(type, _mm_set1_epi32(UMP_TYPE_MIDI1_VOICE)),
+			_mm_and_si128(_mm_cmpgt_epi32(statusHi, _mm_set1_epi32(0x7)),
+						  _mm_cmplt_epi32(statusHi, _mm_set1_epi32(0xF))));
+		// System common / real time, excluding sysex
+		__m128i system = _mm_and_si128(_mm_cmpeq_epi32(type, _mm_set1_epi32(UMP_TYPE_SYSTEM)),
+			_mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi32(status, _mm_set1_epi32(0xF0)),
+										  _mm_cmpeq_epi32(status, _mm_set1_epi32(0xF7))),
+							 _mm_cmpeq_epi32(statusHi, nibble)));
+		__m128i shutdown = _mm_cmpeq_epi32(word, zero);
+		// Utility messages, including the shutdown marker
+		__m128i utility = _mm_cmpeq_epi32(type, zero);
+
+		__m128i rewritten = _mm_or_si128(_mm_and_si128(word, channelMask), channelBits);
+		word = _mm_or_si128(_mm_and_si128(voice, rewritten), _mm_andnot_si128(voice, word));
+		_mm_storeu_si128((__m128i*)(out + i), word);
+
+		regularMask |= 0xFFFF ^ _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(voice, system), utility));
+		shutdownMask |= _mm_movemask_epi8(shutdown);
+	}
+
+	unsigned int flags = batchDecodeTail(in, i, count, channel, out);
+	if (regularMask)
+	{
+		flags |= BATCH_IRREGULAR;
+	}
+	if (shutdownMask)
+	{
+		flags |= BATCH_SHUTDOWN;
+	}
+	return flags;
+}
+
+__attribute__((target("avx2")))
+inline unsigned int
+batchDecodeAVX2(const uint8_t *in, size_t count, unsigned int channel, uint32_t *out)
+{
+	const __m256i bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+										   3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	const __m256i nibble = _mm256_set1_epi32(0x0F);
+	const __m256i channelMask = _mm256_set1_epi32(0xFFF0FFFF);
+	const __m256i channelBits = _mm256_set1_epi32((channel & 0x0F) << 16);
+	const __m256i zero = _mm256_setzero_si256();
+
+	unsigned int regularMask = 0;
+	unsigned int shutdownMask = 0;
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i word = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(in + 4 * i)), bswap);
+		__m256i type = _mm256_srli_epi32(word, 28);
+		__m256i statusHi = _mm256_and_si256(_mm256_srli_epi32(word, 20), nibble);
+		__m256i status = _mm256_and_si256(_mm256_srli_epi32(word, 16), _mm256_set1_epi32(0xFF));
+
+		__m256i voice = _mm256_and_si256(_mm256_cmpeq_epi32(type, _mm256_set1_epi32(UMP_TYPE_MIDI1_VOICE)),
+			_mm256_and_si256(_mm256_cmpgt_epi32(statusHi, _mm256_set1_epi32(0x7)),
+							 _mm256_cmpgt_epi32(_mm256_set1_epi32(0xF), statusHi)));
+		__m256i system = _mm256_and_si256(_mm256_cmpeq_epi32(type, _mm256_set1_epi32(UMP_TYPE_SYSTEM)),
+			_mm256_andnot_si256(_mm256_or_si256(_mm256_cmpeq_epi32(status, _mm256_set1_epi32(0xF0)),
+												_mm256_cmpeq_epi32(status, _mm256_set1_epi32(0xF7))),
+								_mm256_cmpeq_epi32(statusHi, nibble)));
+		__m256i shutdown = _mm256_cmpeq_epi32(word, zero);
+		__m256i utility = _mm256_cmpeq_epi32(type, zero);
+
+		__m256i rewritten = _mm256_or_si256(_mm256_and_si256(word, channelMask), channelBits);
+		word = _mm256_blendv_epi8(word, rewritten, voice);
+		_mm256_storeu_si256((__m256i*)(out + i), word);
+
+		regularMask |= ~(unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(voice, system), utility));
+		shutdownMask |= (unsigned int)_mm256_movemask_epi8(shutdown);
+	}
+
+	unsigned int flags = batchDecodeTail(in, i, count, channel, out);
+	if (regularMask)
+	{
+		flags |= BATCH_IRREGULAR;
+	}
+	if (shutdownMask)
+	{
+		flags |= BATCH_SHUTDOWN;
+	}
+	return flags;
+}
+
+#endif
+
+// Pick the fastest decoder supported by this CPU
+inline BatchDecodeFn
+selectBatchDecoder(const char **name = NULL)
+{
+	const char *selected = "scalar";
+	BatchDecodeFn decoder = batchDecodeScalar;
+#ifdef NDNMIDI_BATCH_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		selected = "avx2";
+		decoder = batchDecodeAVX2;
+	}
+	else if (__builtin_cpu_supports("ssse3"))
+	{
+		selected = "ssse3";
+		decoder = batchDecodeSSSE3;
+	}
+#endif
+	if (name)
+	{
+		*name = selected;
+	}
+	return decoder;
+}
+
+#endif
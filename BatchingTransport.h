@@ -0,0 +1,302 @@
+/********************************
+
+BatchingTransport.h
+
+Face transport to the local forwarder that coalesces writes
+
+ndn-cxx writes every Interest and Data to the forwarder's socket on its
+own. Here packets sent while handling one event-loop turn (a chord, the
+prewarm Interests, the window refill after a burst of Data) are queued
+and written together by one gathered write, posted to run after the
+turn. Packets sent while a write is in flight go out together when it
+completes. With batching off every packet is written as soon as the
+previous write completes, like the ndn-cxx transport, which makes the
+write counters comparable.
+
+Only Unix sockets are supported: the socket is the one in
+NDN_CLIENT_TRANSPORT (unix://<path>) or BATCH_DEFAULT_SOCKET.
+
+********************************/
+
+#ifndef NDNMIDI_BATCHING_TRANSPORT_H
+#define NDNMIDI_BATCHING_TRANSPORT_H
+
+#include <ndn-cxx/transport/transport.hpp>
+#include <ndn-cxx/encoding/block.hpp>
+
+#include <boost/asio.hpp>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+// Forwarder socket used when NDN_CLIENT_TRANSPORT does not name one
+#define BATCH_DEFAULT_SOCKET "/var/run/nfd.sock"
+
+// Receive buffer, room for two packets of the largest size
+#define BATCH_RECEIVE_BUFFER (2 * ndn::MAX_NDN_PACKET_SIZE)
+
+class BatchingTransport : public ndn::Transport
+{
+public:
+	// An empty socketPath picks the forwarder's default socket
+	explicit BatchingTransport(const std::string& socketPath = "", bool batch = true)
+		: m_socketPath(socketPath.empty() ? defaultSocket() : socketPath)
+		, m_batch(batch)
+		, m_flushPosted(false)
+		, m_writing(false)
+		, m_received(0)
+		, m_packets(0)
+		, m_writes(0)
+	{
+	}
+
+	void
+	connect(boost::asio::io_service& ioService, const ReceiveCallback& receiveCallback) override
+	{
+		ndn::Transport::connect(ioService, receiveCallback);
+		m_socket.reset(new boost::asio::local::stream_protocol::socket(ioService));
+		boost::system::error_code error;
+		m_socket->connect(boost::asio::local::stream_protocol::endpoint(m_socketPath), error);
+		if (error)
+		{
+			throw Error(error, "Could not connect to the forwarder at " + m_socketPath);
+		}
+		m_isConnected = true;
+		m_isReceiving = false;
+		resume();
+		flush();
+	}
+
+	void
+	close() override
+	{
+		if (m_socket)
+		{
+			boost::system::error_code error;
+			m_socket->close(error);
+		}
+		m_isConnected = false;
+		m_isReceiving = false;
+		m_writing = false;
+		m_pending.clear();
+		m_parts.clear();
+		m_inFlight.clear();
+	}
+
+	// Reads can only be stopped by cancelling everything, so a write in
+	// flight is let finish first
+	void
+	pause() override
+	{
+		if (m_isReceiving)
+		{
+			m_isReceiving = false;
+			if (!m_writing)
+			{
+				m_socket->cancel();
+			}
+		}
+	}
+
+	void
+	resume() override
+	{
+		if (!m_isReceiving && m_isConnected)
+		{
+			m_isReceiving = true;
+			receive();
+		}
+	}
+
+	void
+	send(const ndn::Block& wire) override
+	{
+		m_pending.push_back(wire);
+		m_parts.push_back(1);
+		++m_packets;
+		schedule();
+	}
+
+	void
+	send(const ndn::Block& header, const ndn::Block& payload) override
+	{
+		m_pending.push_back(header);
+		m_pending.push_back(payload);
+		m_parts.push_back(2);
+		++m_packets;
+		schedule();
+	}
+
+	// Packets sent and socket writes used for them
+	unsigned long
+	getPacketCount() const
+	{
+		return m_packets;
+	}
+
+	unsigned long
+	getWriteCount() const
+	{
+		return m_writes;
+	}
+
+private:
+	static std::string
+	defaultSocket()
+	{
+		const char *transport = getenv("NDN_CLIENT_TRANSPORT");
+		if (transport != NULL && strncmp(transport, "unix://", 7) == 0)
+		{
+			return transport + 7;
+		}
+		return BATCH_DEFAULT_SOCKET;
+	}
+
+	// Write now, or once the current turn has queued everything
+	void
+	schedule()
+	{
+		if (!m_batch)
+		{
+			flush();
+		}
+		else if (!m_flushPosted)
+		{
+			m_flushPosted = true;
+			m_ioService->post(std::bind(&BatchingTransport::flush, this));
+		}
+	}
+
+	void
+	flush()
+	{
+		m_flushPosted = false;
+		if (m_writing || m_pending.empty() || !m_isConnected)
+		{
+			return;
+		}
+		if (m_batch)
+		{
+			m_inFlight.swap(m_pending);
+			m_parts.clear();
+		}
+		else
+		{
+			// One packet per write
+			size_t parts = m_parts.front();
+			m_parts.erase(m_parts.begin());
+			m_inFlight.assign(m_pending.begin(), m_pending.begin() + parts);
+			m_pending.erase(m_pending.begin(), m_pending.begin() + parts);
+		}
+
+		std::vector<boost::asio::const_buffer> buffers;
+		for (const ndn::Block& block : m_inFlight)
+		{
+			buffers.push_back(boost::asio::buffer(block.wire(), block.size()));
+		}
+		m_writing = true;
+		++m_writes;
+		boost::asio::async_write(*m_socket, buffers,
+								 std::bind(&BatchingTransport::onWritten, this, std::placeholders::_1));
+	}
+
+	void
+	onWritten(const boost::system::error_code& error)
+	{
+		m_writing = false;
+		m_inFlight.clear();
+		if (error)
+		{
+			if (error == boost::asio::error::operation_aborted)
+			{
+				return;
+			}
+			close();
+			throw Error(error, "Error while writing to the forwarder");
+		}
+		if (!m_pending.empty())
+		{
+			// Queued during the write, no need to wait for another turn
+			flush();
+		}
+		else if (!m_isReceiving)
+		{
+			m_socket->cancel();
+		}
+	}
+
+	void
+	receive()
+	{
+		m_socket->async_receive(boost::asio::buffer(m_buffer + m_received, BATCH_RECEIVE_BUFFER - m_received),
+								std::bind(&BatchingTransport::onReceived, this,
+										  std::placeholders::_1, std::placeholders::_2));
+	}
+
+	void
+	onReceived(const boost::system::error_code& error, size_t size)
+	{
+		if (error)
+		{
+			if (error == boost::asio::error::operation_aborted)
+			{
+				return;
+			}
+			close();
+			throw Error(error, "Error while receiving from the forwarder");
+		}
+
+		m_received += size;
+		size_t offset = 0;
+		while (offset < m_received)
+		{
+			bool complete;
+			ndn::Block element;
+			std::tie(complete, element) = ndn::Block::fromBuffer(m_buffer + offset, m_received - offset);
+			if (!complete)
+			{
+				break;
+			}
+			offset += element.size();
+			m_receiveCallback(element);
+		}
+		if (offset == 0 && m_received == BATCH_RECEIVE_BUFFER)
+		{
+			close();
+			throw Error("Packet from the forwarder exceeds the receive buffer");
+		}
+		memmove(m_buffer, m_buffer + offset, m_received - offset);
+		m_received -= offset;
+
+		if (m_isReceiving)
+		{
+			receive();
+		}
+	}
+
+	std::string m_socketPath;
+	bool m_batch;
+	std::unique_ptr<boost::asio::local::stream_protocol::socket> m_socket;
+
+	// Packets waiting for the next write, and those being written
+	std::vector<ndn::Block> m_pending;
+	std::vector<ndn::Block> m_inFlight;
+	// Blocks making up each pending packet
+	std::vector<size_t> m_parts;
+	bool m_flushPosted;
+	bool m_writing;
+
+	uint8_t m_buffer[BATCH_RECEIVE_BUFFER];
+	size_t m_received;
+
+	std::atomic<unsigned long> m_packets;
+	std::atomic<unsigned long> m_writes;
+};
+
+#endif
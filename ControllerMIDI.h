@@ -0,0 +1,1543 @@
+/********************************
+
+ControllerMIDI.h
+
+Controller class shared by ControllerMIDI and the midi-ndn-node jam node
+
+Receives MIDI messages from user designated port and sends them to PlaybackModuleMIDI
+
+Sends interest and receives data for connection setup and heartbeat messages
+Sends data for MIDI messages
+
+Every message is timestamped at capture. The playback module's reply to
+the connection handshake carries its clock, from which the offset
+between the two clocks is estimated (NTP style, keeping samples with a
+near-minimal round trip over reconnects) so timestamps are sent in the
+playback module's clock. Heartbeat replies are pre-signed and carry no
+clock.
+Without heartbeats (group sessions) the host clocks are assumed to be
+synchronized.
+
+Data is published under the controller's full prefix and under the
+short prefix /m/<stream id> proposed in every heartbeat, whichever a
+playback module fetches (see StreamNames.h).
+
+Given several playback modules, the first plays and the others are hot
+standbys: they get "standby" heartbeats, which keep their clock offsets
+current without connecting. The active module is probed every
+FAILOVER_PROBE_MS, and each probe reply carries the oldest packet it has
+not received. After FAILOVER_MISSES lost probes the first ready standby
+is told to take over from that packet. Packets after it are answered
+again from the cache of sent packets, so nothing is lost. They are
+followed by a snapshot of the controller, program and pitch bend state.
+
+Data Interests of a connection carry a cumulative ack, the first packet
+the playback module has not received (<prefix>/<ack>/<seqNo>). Sent
+packets are cached until they are acknowledged, so a packet asked for
+again is always answered, and the module drops second copies. Group
+sessions have no single consumer to listen to and keep the last
+SENT_CACHE_PACKETS instead.
+
+Sequenced input (lookahead) is queued seconds before it is due, each
+event with its play time. It is sent as soon as an Interest is waiting,
+in full packets, with a Play-At word after its timestamp, and the
+playback module holds it until then (see UniversalMidiPacket.h).
+
+********************************/
+
+#ifndef NDNMIDI_CONTROLLER_MIDI_H
+#define NDNMIDI_CONTROLLER_MIDI_H
+
+#include <ndn-cxx/face.hpp>
+#include <ndn-cxx/interest.hpp>
+#include <ndn-cxx/data.hpp>
+#include <ndn-cxx/security/key-chain.hpp>
+
+#include <iostream>
+#include <string>
+#include <map>
+#include <chrono>
+#include <thread>
+#include <deque>
+#include <atomic>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+
+#include <stdlib.h>
+#include <string.h>
+#include "RtMidi.h"
+#include "UniversalMidiPacket.h"
+#include "EventTransform.h"
+#include "Tuning.h"
+#include "StreamNames.h"
+#include "WaitStrategy.h"
+#include "Tracepoints.h"
+
+// Microseconds between polls of an idle MIDI input port
+#define MIDI_POLL_US 250
+
+// Maximum number of probes for reconnection
+#define MAX_HEARTBEAT_PROBE 3
+
+// Interval between liveness probes of the active playback module, when
+// there are standbys to fail over to
+#define FAILOVER_PROBE_MS 20
+
+// Lifetime of a liveness probe
+#define FAILOVER_PROBE_TIMEOUT_MS 40
+
+// Consecutive lost probes after which a standby takes over
+#define FAILOVER_MISSES 2
+
+// Number of sent data packets kept to answer again without acks
+#define SENT_CACHE_PACKETS 64
+
+// Most unacknowledged packets kept, should the playback module stall
+#define SENT_CACHE_MAX_PACKETS 4096
+
+// How often sequenced input is queued ahead, and the default lead
+#define LOOKAHEAD_CHUNK_MS 250
+#define LOOKAHEAD_S 2.0
+
+// Statically dispatched RtMidi front end when one backend is compiled in
+#if defined(RTMIDI_SINGLE_BACKEND)
+typedef RtMidiInT<RtMidiStaticBackend> MidiInput;
+#else
+typedef RtMidiIn MidiInput;
+#endif
+
+using sysclock = std::chrono::system_clock;
+
+// A queued message and its capture time in the playback module's clock,
+// and for sequenced input its play time in that clock (0 to play on
+// arrival)
+struct TimedUMPMessage
+{
+	UMPMessage msg;
+	uint64_t captureUs;
+	uint64_t playUs;
+};
+
+// A playback module the controller sends to, or may fail over to
+struct PlaybackTarget
+{
+	std::string name;
+	// Answered the last standby heartbeat
+	bool ready;
+	// Its clock minus the local clock, and the best round trip so far
+	int64_t clockOffsetUs;
+	int64_t minRttUs;
+};
+
+// First controller number of the channel mode messages
+#define MIDI_CHANNEL_MODE_FIRST 120
+
+// Latest controller, program, channel pressure and pitch bend message
+// sent on each channel, to bring a standby taking over to the same state
+class ControllerState
+{
+public:
+	ControllerState()
+	{
+		memset(m_last, 0, sizeof(m_last));
+	}
+
+	void
+	track(const UMPMessage& msg)
+	{
+		if (umpType(msg.word[0]) != UMP_TYPE_MIDI1_VOICE)
+		{
+			return;
+		}
+		unsigned int status = umpStatus(msg.word[0]);
+		uint32_t *last = m_last[status & 15];
+		std::lock_guard<std::mutex> lock(m_mutex);
+		switch (status & 0xF0)
+		{
+		case 0xB0:
+			// Channel mode messages (120-127) are actions, not state:
+			// replayed, they would undo the controllers restored before
+			if (((msg.word[0] >> 8) & 0x7F) < MIDI_CHANNEL_MODE_FIRST)
+			{
+				last[(msg.word[0] >> 8) & 0x7F] = msg.word[0];
+			}
+			break;
+		case 0xC0:
+			last[128] = msg.word[0];
+			break;
+		case 0xD0:
+			last[129] = msg.word[0];
+			break;
+		case 0xE0:
+			last[130] = msg.word[0];
+			break;
+		}
+	}
+
+	// Messages restoring the tracked state, controllers (and so bank
+	// select) before programs
+	std::vector<UMPMessage>
+	snapshot()
+	{
+		std::vector<UMPMessage> messages;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (int channel = 0; channel < 16; channel++)
+		{
+			for (int i = 0; i < 131; i++)
+			{
+				if (m_last[channel][i] != 0)
+				{
+					UMPMessage msg = {{m_last[channel][i]}};
+					messages.push_back(msg);
+				}
+			}
+		}
+		return messages;
+	}
+
+	void
+	clear()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		memset(m_last, 0, sizeof(m_last));
+	}
+
+private:
+	std::mutex m_mutex;
+	// 128 controllers (the channel mode ones unused), program, channel
+	// pressure and pitch bend
+	uint32_t m_last[16][131];
+};
+
+
+class Controller
+{
+public:
+	// A standalone Controller registers its own prefix and runs its own
+	// heartbeat thread. Otherwise the owner (e.g. the jam node) must pass
+	// it interests through onInterest() and call heartbeatTick().
+	// remoteName may list several playback modules separated by commas,
+	// the primary first and then the standbys in order of preference.
+	Controller(ndn::Face& face, ndn::KeyChain& keyChain, const std::string& remoteName,
+	const std::string& devName, const std::string& projName, bool standalone = true)
+		: m_face(face)
+		, m_keyChain(keyChain)
+		, m_baseName(ndn::Name("/topo-prefix/" + devName + "/midi-ndn/" + projName))
+		, m_projName(projName)
+		, m_devName(devName)
+		, m_standalone(standalone)
+	{
+		srand(sysclock::to_time_t(sysclock::now()));
+		m_connGood = false;
+		m_maxSeqNo = 0;
+		m_hbCount = 0;
+		m_lastPublished = -1;
+		m_clockOffsetUs = 0;
+		m_active = 0;
+		m_probeMisses = 0;
+		m_playedSeqNo = 0;
+		m_lastSentSeqNo = -1;
+		m_ackedSeqNo = -1;
+		m_sentMessages = 0;
+		m_sendDelayUs = 0;
+		m_inputCount = 0;
+		m_shutdownQueued = 0;
+		m_clearInputPending = false;
+		m_takeoverPending = false;
+		m_stopping = false;
+		m_tuning = std::make_shared<Tuning>();
+		m_streamId = newStreamId();
+		std::istringstream remotes(remoteName);
+		std::string name;
+		while (std::getline(remotes, name, ','))
+		{
+			PlaybackTarget target = {name, false, 0, 0};
+			m_targets.push_back(target);
+		}
+		if (m_targets.empty())
+		{
+			PlaybackTarget target = {"", false, 0, 0};
+			m_targets.push_back(target);
+		}
+		for (int i = 0; i < 8; i++)
+		{
+			m_dropStatus[i] = 0;
+		}
+		heartbeatNonce = rand();
+		if (m_standalone)
+		{
+			m_face.setInterestFilter(m_baseName,
+									 std::bind(&Controller::onInterest, this, _2),
+									 std::bind(&Controller::onSuccess, this, _1),
+									 [] (const ndn::Name& prefix, const std::string& reason) {
+										std::cerr << "Failed to register prefix: " << reason << std::endl;
+									 });
+			m_face.setInterestFilter(getStreamPrefix(),
+									 std::bind(&Controller::onInterest, this, _2),
+									 [] (const ndn::Name& prefix) {},
+									 [] (const ndn::Name& prefix, const std::string& reason) {
+										std::cerr << "Failed to register prefix: " << reason << std::endl;
+									 });
+		}
+		if (m_targets.size() > 1)
+		{
+			failoverProbe = std::thread(&Controller::sendProbes, this);
+		}
+	}
+
+	// Stop the heartbeat and probe threads, so main can return early
+	~Controller()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_stopMutex);
+			m_stopping = true;
+		}
+		m_stopWake.notify_all();
+		if (heartbeatProbe.joinable())
+		{
+			heartbeatProbe.join();
+		}
+		if (failoverProbe.joinable())
+		{
+			failoverProbe.join();
+		}
+	}
+
+
+	// Add a UMPMessage captured now to the input queue
+	void
+	addInput(const UMPMessage& msg)
+	{
+		TimedUMPMessage timed = {msg, umpClockMicros() + m_clockOffsetUs.load(), 0};
+		pushInput(timed);
+	}
+
+	// Add a sequenced MIDI 1.0 message to the input queue, to be played
+	// at playUs (umpClockMicros() of this host)
+	void
+	addScheduledInput(const unsigned char *bytes, size_t size, uint64_t playUs)
+	{
+		if (size == 0 || ((m_dropStatus[bytes[0] >> 5] >> (bytes[0] & 31)) & 1))
+		{
+			return;
+		}
+		int64_t offsetUs = m_clockOffsetUs.load();
+		TimedUMPMessage timed = {{{UMP_SHUTDOWN}}, umpClockMicros() + offsetUs, playUs + offsetUs};
+		if (!midi1ToUMP(bytes, size, 0, timed.msg))
+		{
+			return;
+		}
+		pushInput(timed);
+	}
+
+	// Convert a MIDI 1.0 message to a UMPMessage
+	// Add the UMPMessage to the input queue
+	// An empty message queues the shutdown marker
+	void
+	addInput(const unsigned char *bytes, size_t size)
+	{
+		// The playback module filters these out anyway
+		if (size > 0 && ((m_dropStatus[bytes[0] >> 5] >> (bytes[0] & 31)) & 1))
+		{
+			return;
+		}
+		UMPMessage umpMsg = {{UMP_SHUTDOWN}};
+		if (size > 0 && !midi1ToUMP(bytes, size, 0, umpMsg))
+		{
+			// Not representable (e.g. sysex), drop
+			return;
+		}
+		addInput(umpMsg);
+	}
+
+	void
+	addInput(const std::string& msg)
+	{
+		addInput(reinterpret_cast<const unsigned char*>(msg.data()), msg.size());
+	}
+	
+	// Group session mode: there is no heartbeat, the owner decides
+	// whether anyone is listening
+	void
+	setConnected(bool connected)
+	{
+		if (connected && !m_connGood)
+		{
+			m_maxSeqNo = 0;
+			m_lastPublished = -1;
+			resetSent();
+		}
+		m_connGood = connected;
+		m_sendWait.notify();
+	}
+
+	// Wakes the send thread when input or an interest is queued
+	WaitStrategy&
+	getSendWait()
+	{
+		return m_sendWait;
+	}
+
+	// Microseconds until held input is due, 0 if none is held; for the
+	// send thread after replyInterest()
+	unsigned int
+	getSendDelayUs() const
+	{
+		return m_sendDelayUs;
+	}
+
+	// Messages and interests waiting to be matched
+	size_t
+	getQueueDepth()
+	{
+		std::lock_guard<std::mutex> lock(m_interestMutex);
+		return m_inputCount.load() + m_interestQueue.size();
+	}
+
+	// MIDI messages sent in data packets so far
+	unsigned long
+	getSentMessageCount() const
+	{
+		return m_sentMessages;
+	}
+
+	// Short prefix of our data names, which the owner of a Controller
+	// that is not standalone must also pass to onInterest()
+	ndn::Name
+	getStreamPrefix() const
+	{
+		return shortStreamPrefix(m_streamId);
+	}
+
+	// Replace the packet size and heartbeat period
+	void
+	setTuning(const Tuning& tuning)
+	{
+		std::atomic_store(&m_tuning, std::shared_ptr<const Tuning>(std::make_shared<Tuning>(tuning)));
+	}
+
+	std::shared_ptr<const Tuning>
+	getTuning()
+	{
+		return std::atomic_load(&m_tuning);
+	}
+
+	// Called with the sequence number of every data packet sent
+	void
+	setPublishCallback(const std::function<void(uint64_t)>& onPublish)
+	{
+		m_onPublish = onPublish;
+	}
+
+	// If input and interest queues are not empty
+	// sends up to maxBufSize midi messages in a packet
+	// With a batch deadline, input is held until the oldest event has
+	// waited that long or a packet is full
+	// Sequenced input goes out at once, up to TUNING_MAX_PACKET_MESSAGES
+	// Returns whether a packet was sent
+	bool
+	replyInterest()
+	{
+		m_sendDelayUs = 0;
+		// Packets asked for again, queued by onInterest
+		std::deque<ndn::Name> resends;
+		{
+			std::lock_guard<std::mutex> lock(m_interestMutex);
+			resends.swap(m_resendQueue);
+		}
+		for (size_t i = 0; i < resends.size(); i++)
+		{
+			resend(resends[i], seqOf(resends[i]));
+		}
+		if (!resends.empty())
+		{
+			return true;
+		}
+
+		// Input queued before the connection was set up
+		if (m_clearInputPending.exchange(false))
+		{
+			clearInput();
+		}
+		// The state snapshot of a takeover goes ahead of queued input
+		if (m_takeoverPending.exchange(false))
+		{
+			queueSnapshot();
+		}
+		bool snapshotDue = !m_snapshotQueue.empty();
+
+		std::unique_lock<std::mutex> lock(m_interestMutex);
+		// If not connected, queue will be cleared
+		if (!m_connGood)
+		{
+			clearInput();
+			m_snapshotQueue.clear();
+			snapshotDue = false;
+			m_interestQueue.clear();
+		}
+
+		// TODO: Verify this is right logic - what if no interests? Notes lost?
+		if ((snapshotDue || m_inputCount.load() > 0) && !m_interestQueue.empty())
+		{
+			std::shared_ptr<const Tuning> tuning = getTuning();
+			int midiMsgCount = 0;
+			int maxMsgCount = tuning->packetMessages;
+			uint64_t now = umpClockMicros() + m_clockOffsetUs.load();
+			TimedUMPMessage oldest = {{{UMP_SHUTDOWN}}, now, 0};
+			if (!snapshotDue)
+			{
+				// Only this thread removes input, so the queue is not empty
+				std::lock_guard<std::mutex> inputLock(m_inputMutex);
+				oldest = m_inputQueue.front();
+			}
+			if (snapshotDue || oldest.playUs != 0)
+			{
+				maxMsgCount = TUNING_MAX_PACKET_MESSAGES;
+			}
+			else if (tuning->batchDeadlineUs > 0)
+			{
+				maxMsgCount = TUNING_MAX_PACKET_MESSAGES;
+				uint64_t dueUs = oldest.captureUs + tuning->batchDeadlineUs;
+				if (now < dueUs && m_inputCount.load() < TUNING_MAX_PACKET_MESSAGES
+					&& m_shutdownQueued.load() == 0)
+				{
+					m_sendDelayUs = std::min<uint64_t>(dueUs - now, tuning->batchDeadlineUs);
+					return false;
+				}
+			}
+
+			// Name data packet using interest sequence number
+			ndn::Name interestName = m_interestQueue.front();
+			m_interestQueue.pop_front();
+			lock.unlock();
+
+			// Take up to max number of notes for the packet, the state
+			// snapshot first
+			m_sendBatch.clear();
+			while (!m_snapshotQueue.empty() && (int)m_sendBatch.size() < maxMsgCount)
+			{
+				m_sendBatch.push_back(m_snapshotQueue.front());
+				m_snapshotQueue.pop_front();
+			}
+			takeInput(m_sendBatch, maxMsgCount - m_sendBatch.size());
+
+			size_t midiBufSize = 0;
+			std::cout << "Sending Data: ";
+			for (size_t n = 0; n < m_sendBatch.size(); n++){
+				const TimedUMPMessage& timed = m_sendBatch[n];
+				const UMPMessage& msg = timed.msg;
+				// Capture time precedes the message, except for shutdown
+				if (timed.playUs != 0)
+				{
+					// Sequenced events are stamped as sent, so the stamp
+					// never ages past its wrap however long they queued
+					umpWrite(umpJRTimestamp(now), midiBuf + midiBufSize);
+					umpWrite(umpPlayAt(timed.playUs > now ? timed.playUs - now : 0), midiBuf + midiBufSize + 4);
+					midiBufSize += 8;
+				}
+				else if (msg.word[0] != UMP_SHUTDOWN)
+				{
+					umpWrite(umpJRTimestamp(timed.captureUs), midiBuf + midiBufSize);
+					midiBufSize += 4;
+				}
+				// Write UMP words in network byte order
+				for (unsigned int i = 0; i < umpWordCount(msg.word[0]); ++i) {
+					umpWrite(msg.word[i], midiBuf + midiBufSize);
+					midiBufSize += 4;
+				}
+				m_state.track(msg);
+				// Print status and data bytes of the message
+				std::cout << "[";
+				std::cout << " " << ((msg.word[0] >> 20) & 15);
+				std::cout << " " << ((msg.word[0] >> 8) & 0x7F);
+				std::cout << " " << (msg.word[0] & 0x7F);
+				std::cout << "] ";
+				midiMsgCount++;
+			}
+			std::cout << std::endl;
+			m_sentMessages += midiMsgCount;
+
+
+			int seqNo = interestName.get(-1).toSequenceNumber();
+			NDNMIDI_TRACE3(reply_interest, seqNo, midiMsgCount, midiBufSize);
+			sendData(interestName, (char *)midiBuf, midiBufSize);
+			raiseTo(m_lastSentSeqNo, seqNo);
+			if (m_onPublish)
+			{
+				m_lastPublished = seqNo;
+				m_onPublish(seqNo);
+			}
+			return true;
+		}
+		return false;
+	}
+
+	// Add interest to interest queue or drop interest
+	void
+	onInterest(const ndn::Interest& interest)
+	{
+		try 
+		{
+			if (interest.getName().get(-1).toUri() == "shutdown") 
+			{
+				std::cout << "Shutting Down" << std::endl;
+				throw "e";
+				return;
+			}
+		}
+		catch (const char* e) 
+		{
+		std::cerr << "Disconnected from Playback Module" << std::endl;
+		if (m_standalone)
+		{
+			exit(1);
+		}
+		// Shared process keeps running, wait for the next handshake
+		m_connGood = false;
+		return;
+		}
+
+
+		if (!m_connGood)
+		{
+			std::cerr << "Connection not set up yet!?" << std::endl;
+			return;
+		}
+
+		/*** send out data of keyboard input ***/
+
+		if (m_inputCount.load() == 0)
+		{
+			// std::cerr << "\nReceived interest but no more data to send."
+			// 		  << std::endl;
+		}
+
+		// Consider out-of-order or retransmitted interest
+		int seqNo = interest.getName().get(-1).toSequenceNumber();
+		NDNMIDI_TRACE3(interest, seqNo, m_maxSeqNo.load(), umpClockMicros());
+		int ack = ackOf(interest.getName());
+		if (ack >= 0)
+		{
+			acknowledge(ack);
+		}
+		
+		// Already sent, e.g. to a module that failed before playing it;
+		// the send thread signs the copy
+		if (seqNo <= m_lastSentSeqNo && isCached(seqNo))
+		{
+			std::lock_guard<std::mutex> lock(m_interestMutex);
+			m_resendQueue.push_back(interest.getName());
+			raiseTo(m_maxSeqNo, seqNo + 1);
+			m_sendWait.notify();
+		}
+		else if (seqNo >= m_maxSeqNo)
+		{
+			std::lock_guard<std::mutex> lock(m_interestMutex);
+			m_interestQueue.push_back(interest.getName());
+			m_maxSeqNo = seqNo + 1;
+			m_sendWait.notify();
+		}
+		else if (((m_onPublish && seqNo > m_lastPublished) || (ack >= 0 && seqNo >= ack))
+				 && !isQueued(seqNo))
+		{
+			// Group member that joined late and asks for a packet not
+			// sent yet, which the others' interests have already claimed,
+			// or a packet not acknowledged, so never sent: its first
+			// Interest was lost
+			std::lock_guard<std::mutex> lock(m_interestMutex);
+			m_interestQueue.push_back(interest.getName());
+			std::sort(m_interestQueue.begin(), m_interestQueue.end(), [] (const ndn::Name& a, const ndn::Name& b) {
+				return seqOf(a) < seqOf(b);
+			});
+			m_sendWait.notify();
+		}
+		else
+		{
+			std::cerr << "Dropped out-of-order packet" << std::endl;
+		}
+	}
+
+	// Data should be heartbeat message or connection setup
+	// sentUs is when the heartbeat was sent to target
+	void
+	onData(const ndn::Data& data, uint64_t sentUs, size_t target)
+	{
+		// Exit if not a heartbeat message, or for a module given up on
+		if (data.getName().get(-1).toUri() != "heartbeat" || target != m_active)
+		{
+			return;
+		}
+
+		std::string content(reinterpret_cast<const char*>(data.getContent().value()),
+							data.getContent().value_size());
+		updateClockOffset(content, sentUs, target);
+		updateSourceFilter(content);
+
+		if (m_connGood)
+		{
+			//std::cerr << "Heartbeat!" << std::endl;
+			m_hbCount = 0;
+			return;
+		}
+
+		// Set up connection
+		m_connGood = true;
+		m_hbCount = 0;
+		m_clearInputPending = true;
+		m_sendWait.notify();
+		{
+			std::lock_guard<std::mutex> lock(m_interestMutex);
+			m_interestQueue.clear();
+		}
+		m_maxSeqNo = 0;	// reset seqNo tracking
+		m_playedSeqNo = 0;
+		m_probeMisses = 0;
+		resetSent();
+
+		std::cout << "Received data: " << content << std::endl;
+
+		//std::cout << "Data name: " << data.getName().toUri() << std::endl;
+	}
+
+	// Send one heartbeat probe, resetting the connection after too many
+	// unanswered probes; called every heartbeat period
+	void
+	heartbeatTick()
+	{
+		// Try the next module while the current one does not answer
+		if (!m_connGood && m_hbCount > 1 && m_targets.size() > 1)
+		{
+			m_active = (m_active + 1) % m_targets.size();
+		}
+
+		m_hbCount += 1;
+		// Send interest for heartbeat message
+		requestNext();
+
+		// Keep the standbys warm
+		for (size_t i = 0; i < m_targets.size(); i++)
+		{
+			if (i != m_active)
+			{
+				m_face.expressInterest(ndn::Interest(controlName(i, "standby"))
+										.setMustBeFresh(true)
+										.setInterestLifetime(ndn::time::seconds(getTuning()->heartbeatPeriodS)),
+										std::bind(&Controller::onStandbyData, this, _2, umpClockMicros(), i),
+										std::bind(&Controller::onStandbyLost, this, i),
+										std::bind(&Controller::onStandbyLost, this, i));
+			}
+		}
+		//std::cerr << "HEARTBEAT: " << m_hbCount << std::endl;
+
+		if (m_hbCount > MAX_HEARTBEAT_PROBE && m_connGood)
+		{
+			//std::cerr << "Heartbeat failed! Resetting connection..." << std::endl;
+			std::cerr << "Resetting connection..." << std::endl;
+			m_connGood = false;
+		}
+	}
+
+private:
+	// Creates thread to send heartbeat message
+	void
+	onSuccess(const ndn::Name& prefix)
+	{
+		std::cerr << "Prefix registered" << std::endl;
+		heartbeatProbe = std::thread(&Controller::sendHeartbeat, this);
+	}
+
+	// For future: Maybe implement at least a message
+	void
+	onTimeout(const ndn::Interest& interest)
+	{
+		// re-express interest: no need to retransmit for this case (?)
+		//std::cerr << "Timeout for: " << interest << std::endl;
+		//m_face.expressInterest(interest.getName(),
+		//						std::bind(&Controller::onData, this, _2),
+		//						std::bind(&Controller::onTimeout, this, _1));
+	}
+	
+	// For future: Maybe implement at least a message
+	void
+	onNetworkNack(const ndn::Interest& interest)
+	{
+
+	}
+
+	// Estimate the clock offset of target from a reply "<verdict>
+	// <playback time in us>" to an Interest sent at sentUs, assuming
+	// symmetric paths
+	void
+	updateClockOffset(const std::string& content, uint64_t sentUs, size_t target)
+	{
+		std::istringstream fields(content);
+		std::string verdict;
+		uint64_t remoteUs = 0;
+		if (!(fields >> verdict >> remoteUs))
+		{
+			return;
+		}
+		PlaybackTarget& playback = m_targets[target];
+		uint64_t now = umpClockMicros();
+		int64_t rtt = now - sentUs;
+		int64_t offset = (int64_t)remoteUs - (int64_t)(sentUs + now) / 2;
+
+		// Samples delayed by queueing have a skewed offset, skip them
+		if (playback.minRttUs == 0 || rtt < playback.minRttUs)
+		{
+			playback.minRttUs = rtt;
+			playback.clockOffsetUs = offset;
+		}
+		else if (rtt <= 2 * playback.minRttUs)
+		{
+			// Follow clock drift
+			playback.clockOffsetUs += (offset - playback.clockOffsetUs) / 4;
+		}
+		if (target == m_active)
+		{
+			m_clockOffsetUs = playback.clockOffsetUs;
+		}
+	}
+
+	// Take the status filter from a handshake reply
+	// "ACCEPTED <time> <filter>", so filtered messages are never sent
+	void
+	updateSourceFilter(const std::string& content)
+	{
+		std::istringstream fields(content);
+		std::string verdict, remoteTime, filterHex;
+		uint32_t dropStatus[8];
+		if (!(fields >> verdict >> remoteTime >> filterHex) || !parseStatusFilterHex(filterHex, dropStatus))
+		{
+			return;
+		}
+		for (int i = 0; i < 8; i++)
+		{
+			m_dropStatus[i] = dropStatus[i];
+		}
+	}
+
+	// Name of a control Interest for our connection with target
+	ndn::Name
+	controlName(size_t target, const std::string& kind)
+	{
+		return ndn::Name("/topo-prefix/" + m_targets[target].name + "/midi-ndn/" + m_projName)
+			.append(m_devName + "/" + kind);
+	}
+
+	// Request heartbeat from playback module
+	void
+	requestNext()
+	{
+		heartbeatNonce = rand();
+		size_t target = m_active;
+		// Express interest for heartbeat message
+		m_face.expressInterest(ndn::Interest(controlName(target, "heartbeat").appendNumber(m_streamId))
+								.setMustBeFresh(true)
+								.setInterestLifetime(ndn::time::seconds(getTuning()->heartbeatPeriodS))
+								.setNonce(heartbeatNonce),
+								std::bind(&Controller::onData, this, _2, umpClockMicros(), target),
+								std::bind(&Controller::onTimeout, this, _1),
+								std::bind(&Controller::onNetworkNack, this, _1));
+		
+		//std::cerr << "Sending out interest: " << m_baseName << std::endl;
+	}
+
+	// Respond to interest with data
+	void
+	sendData(const ndn::Name& dataName, const char *buf, size_t size)
+	{
+		// Create data packet with the same name as interest
+		std::shared_ptr<ndn::Data> data = std::make_shared<ndn::Data>(dataName);
+
+		// Prepare and assign content of the data packet
+		data->setContent(reinterpret_cast<const uint8_t*>(buf), size);
+
+		// Set metainfo parameters
+		data->setFreshnessPeriod(ndn::time::seconds(1));
+
+		// Sign data packet
+		m_keyChain.sign(*data);
+
+		// Make data packet available for fetching
+		m_face.put(*data);
+		NDNMIDI_TRACE3(send_data, dataName.get(-1).toSequenceNumber(), size, umpClockMicros());
+
+		std::lock_guard<std::mutex> lock(m_sentMutex);
+		m_sentCache.push_back(data);
+		if (m_sentCache.size() > (m_ackedSeqNo >= 0 ? SENT_CACHE_MAX_PACKETS : SENT_CACHE_PACKETS))
+		{
+			m_sentCache.pop_front();
+		}
+	}
+
+	// Sequence number of a data name
+	static int
+	seqOf(const ndn::Name& name)
+	{
+		return name.get(-1).toSequenceNumber();
+	}
+
+	// Cumulative ack of a data Interest, <prefix>/<ack>/<seqNo>, or -1
+	int
+	ackOf(const ndn::Name& name)
+	{
+		size_t prefixSize = isShortStreamName(name) ? 2 : m_baseName.size();
+		if (name.size() != prefixSize + 2 || !name.get(-2).isNumber())
+		{
+			return -1;
+		}
+		return name.get(-2).toNumber();
+	}
+
+	// Forget the sent packets before ack, which the playback module has
+	// received; in a group session other members may still need them
+	void
+	acknowledge(int ack)
+	{
+		if (m_onPublish)
+		{
+			return;
+		}
+		raiseTo(m_playedSeqNo, ack);
+		std::lock_guard<std::mutex> lock(m_sentMutex);
+		raiseTo(m_ackedSeqNo, ack);
+		while (!m_sentCache.empty() && seqOf(m_sentCache.front()->getName()) < ack)
+		{
+			m_sentCache.pop_front();
+		}
+	}
+
+	// Whether sent packet seqNo can still be sent again
+	bool
+	isCached(int seqNo)
+	{
+		std::lock_guard<std::mutex> lock(m_sentMutex);
+		for (const std::shared_ptr<ndn::Data>& data : m_sentCache)
+		{
+			if ((int)data->getName().get(-1).toSequenceNumber() == seqNo)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Put sent packet seqNo again, as dataName if it was sent under the
+	// stream's other name; returns false if it is no longer cached
+	// Send thread only, as the copy is signed like any other packet
+	bool
+	resend(const ndn::Name& dataName, int seqNo)
+	{
+		std::shared_ptr<ndn::Data> sent;
+		{
+			std::lock_guard<std::mutex> lock(m_sentMutex);
+			for (const std::shared_ptr<ndn::Data>& data : m_sentCache)
+			{
+				if ((int)data->getName().get(-1).toSequenceNumber() == seqNo)
+				{
+					sent = data;
+				}
+			}
+		}
+		if (!sent)
+		{
+			return false;
+		}
+		if (sent->getName() == dataName)
+		{
+			m_face.put(*sent);
+		}
+		else
+		{
+			sendData(dataName, reinterpret_cast<const char*>(sent->getContent().value()),
+					 sent->getContent().value_size());
+		}
+		return true;
+	}
+
+	// Sequence numbers restart with every connection
+	void
+	resetSent()
+	{
+		std::lock_guard<std::mutex> lock(m_sentMutex);
+		m_sentCache.clear();
+		m_ackedSeqNo = -1;
+		m_lastSentSeqNo = -1;
+		m_state.clear();
+	}
+
+	// Probe the active module every FAILOVER_PROBE_MS while connected
+	void
+	sendProbes()
+	{
+		for (uint64_t probeNo = 0; sleepUnlessStopped(std::chrono::milliseconds(FAILOVER_PROBE_MS)); ++probeNo)
+		{
+			if (!m_connGood)
+			{
+				continue;
+			}
+			// Numbered so probes are never aggregated with lost ones
+			size_t target = m_active;
+			m_face.expressInterest(ndn::Interest(controlName(target, "probe").appendNumber(probeNo))
+									.setMustBeFresh(true)
+									.setInterestLifetime(ndn::time::milliseconds(FAILOVER_PROBE_TIMEOUT_MS)),
+									std::bind(&Controller::onProbeData, this, _2, target),
+									std::bind(&Controller::onProbeLost, this, target),
+									std::bind(&Controller::onProbeLost, this, target));
+		}
+	}
+
+	// "ALIVE <oldest packet not received>"
+	void
+	onProbeData(const ndn::Data& data, size_t target)
+	{
+		if (target != m_active)
+		{
+			return;
+		}
+		m_probeMisses = 0;
+		std::string content(reinterpret_cast<const char*>(data.getContent().value()),
+							data.getContent().value_size());
+		std::istringstream fields(content);
+		std::string verdict;
+		int oldestMissing;
+		if (fields >> verdict >> oldestMissing)
+		{
+			raiseTo(m_playedSeqNo, oldestMissing);
+		}
+	}
+
+	void
+	onProbeLost(size_t target)
+	{
+		if (target == m_active && m_connGood && ++m_probeMisses >= FAILOVER_MISSES)
+		{
+			failover();
+		}
+	}
+
+	// "STANDBY <playback time in us>"
+	void
+	onStandbyData(const ndn::Data& data, uint64_t sentUs, size_t target)
+	{
+		std::string content(reinterpret_cast<const char*>(data.getContent().value()),
+							data.getContent().value_size());
+		updateClockOffset(content, sentUs, target);
+		m_targets[target].ready = true;
+	}
+
+	void
+	onStandbyLost(size_t target)
+	{
+		m_targets[target].ready = false;
+	}
+
+	// Switch to the first ready standby after the active module, which
+	// resumes at the first packet the active module had not played
+	void
+	failover()
+	{
+		size_t failed = m_active;
+		size_t next = failed;
+		for (size_t i = 1; i < m_targets.size(); i++)
+		{
+			size_t candidate = (failed + i) % m_targets.size();
+			if (m_targets[candidate].ready)
+			{
+				next = candidate;
+				break;
+			}
+		}
+		if (next == failed)
+		{
+			std::cerr << "Lost " << m_targets[failed].name << ", no standby ready" << std::endl;
+			m_probeMisses = 0;
+			return;
+		}
+		std::cerr << "Failing over from " << m_targets[failed].name << " to "
+				  << m_targets[next].name << " at packet " << m_playedSeqNo.load() << std::endl;
+
+		m_targets[next].ready = false;
+		m_active = next;
+		m_probeMisses = 0;
+		m_hbCount = 0;
+		m_clockOffsetUs = m_targets[next].clockOffsetUs;
+
+		// The standby asks for everything from there on
+		{
+			std::lock_guard<std::mutex> lock(m_interestMutex);
+			m_interestQueue.clear();
+		}
+		int resumeSeqNo = m_playedSeqNo.load();
+		m_maxSeqNo = resumeSeqNo;
+
+		// Controllers, programs and bends in effect come first, packed
+		// by the send thread ahead of the input queue
+		m_takeoverPending = true;
+		m_sendWait.notify();
+
+		m_face.expressInterest(ndn::Interest(controlName(next, "takeover").appendSequenceNumber(resumeSeqNo).appendNumber(m_streamId))
+								.setMustBeFresh(true)
+								.setInterestLifetime(ndn::time::seconds(1)),
+								std::bind(&Controller::onTakeoverData, this, _2, umpClockMicros(), next),
+								std::bind(&Controller::onTakeoverLost, this, next),
+								std::bind(&Controller::onTakeoverLost, this, next));
+
+		// Should the old module still be alive, it must stop playing
+		m_face.expressInterest(ndn::Interest(controlName(failed, "release"))
+								.setMustBeFresh(true)
+								.setInterestLifetime(ndn::time::seconds(1)),
+								std::bind(&Controller::onNetworkNack, this, _1),
+								std::bind(&Controller::onTimeout, this, _1),
+								std::bind(&Controller::onTimeout, this, _1));
+	}
+
+	// "ACCEPTED <time> <filter>" or "DENIED"
+	void
+	onTakeoverData(const ndn::Data& data, uint64_t sentUs, size_t target)
+	{
+		std::string content(reinterpret_cast<const char*>(data.getContent().value()),
+							data.getContent().value_size());
+		if (content.compare(0, 8, "ACCEPTED") != 0)
+		{
+			onTakeoverLost(target);
+			return;
+		}
+		updateClockOffset(content, sentUs, target);
+		updateSourceFilter(content);
+	}
+
+	// Try the next standby
+	void
+	onTakeoverLost(size_t target)
+	{
+		if (target == m_active && m_connGood)
+		{
+			failover();
+		}
+	}
+
+	// Whether an Interest for seqNo is waiting
+	bool
+	isQueued(int seqNo)
+	{
+		std::lock_guard<std::mutex> lock(m_interestMutex);
+		return std::find_if(m_interestQueue.begin(), m_interestQueue.end(), [seqNo] (const ndn::Name& name) {
+			return seqOf(name) == seqNo;
+		}) != m_interestQueue.end();
+	}
+
+	// Queue the messages restoring the controller state, which go out
+	// before any queued input; send thread only, as is m_snapshotQueue
+	void
+	queueSnapshot()
+	{
+		std::vector<UMPMessage> snapshot = m_state.snapshot();
+		uint64_t now = umpClockMicros() + m_clockOffsetUs.load();
+		m_snapshotQueue.clear();
+		for (size_t i = 0; i < snapshot.size(); i++)
+		{
+			TimedUMPMessage timed = {snapshot[i], now, 0};
+			m_snapshotQueue.push_back(timed);
+		}
+	}
+
+	// Sleep for period on a probe thread; returns false as soon as the
+	// controller is being destroyed
+	template <typename Duration>
+	bool
+	sleepUnlessStopped(const Duration& period)
+	{
+		std::unique_lock<std::mutex> lock(m_stopMutex);
+		return !m_stopWake.wait_for(lock, period, [this] { return m_stopping; });
+	}
+
+	// Raise a sequence number updated from several threads
+	static void
+	raiseTo(std::atomic<int>& seqNo, int value)
+	{
+		int current = seqNo.load();
+		while (current < value && !seqNo.compare_exchange_weak(current, value))
+		{
+		}
+	}
+
+	// Append to the input queue and wake the send thread
+	void
+	pushInput(const TimedUMPMessage& timed)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_inputMutex);
+			m_inputQueue.push_back(timed);
+			if (timed.msg.word[0] == UMP_SHUTDOWN)
+			{
+				++m_shutdownQueued;
+			}
+			++m_inputCount;
+		}
+		NDNMIDI_TRACE3(add_input, timed.captureUs, timed.msg.word[0], m_inputCount.load());
+		m_sendWait.notify();
+	}
+
+	// Move up to count messages from the input queue to out; send thread only
+	void
+	takeInput(std::vector<TimedUMPMessage>& out, size_t count)
+	{
+		std::lock_guard<std::mutex> lock(m_inputMutex);
+		for (; count > 0 && !m_inputQueue.empty(); count--)
+		{
+			if (m_inputQueue.front().msg.word[0] == UMP_SHUTDOWN)
+			{
+				--m_shutdownQueued;
+			}
+			out.push_back(m_inputQueue.front());
+			m_inputQueue.pop_front();
+			--m_inputCount;
+		}
+	}
+
+	// Send thread only; other threads set m_clearInputPending
+	void
+	clearInput()
+	{
+		std::lock_guard<std::mutex> lock(m_inputMutex);
+		m_inputQueue.clear();
+		m_inputCount = 0;
+		m_shutdownQueued = 0;
+	}
+
+	// Send interest for heartbeat message or reset connection
+	void
+	sendHeartbeat()
+	{
+		do
+		{
+			heartbeatTick();
+		}
+		while (sleepUnlessStopped(std::chrono::seconds(getTuning()->heartbeatPeriodS)));
+	}
+
+	ndn::Face& m_face;
+	ndn::KeyChain& m_keyChain;
+	ndn::Name m_baseName;
+
+	std::string m_projName;
+
+	// Connection and sequence state is written by the face, heartbeat
+	// and probe threads and read by the send thread
+	std::atomic<bool> m_connGood;
+	std::string m_devName;
+	bool m_standalone;
+	// Appended to by the capture thread, emptied by the send thread
+	std::deque<TimedUMPMessage> m_inputQueue;
+	std::mutex m_inputMutex;
+	// Length of m_inputQueue and shutdown markers in it, changed under
+	// m_inputMutex and read without it for the batch hold
+	std::atomic<size_t> m_inputCount;
+	std::atomic<unsigned int> m_shutdownQueued;
+	std::atomic<bool> m_clearInputPending;
+	// Messages of the packet being built; send thread only
+	std::vector<TimedUMPMessage> m_sendBatch;
+	// Filled on the face thread, emptied by the send thread
+	std::deque<ndn::Name> m_interestQueue;
+	std::deque<ndn::Name> m_resendQueue;
+	std::mutex m_interestMutex;
+	// A takeover's state snapshot is waiting for the send thread
+	std::atomic<bool> m_takeoverPending;
+	std::deque<TimedUMPMessage> m_snapshotQueue;
+	WaitStrategy m_sendWait;
+	unsigned int m_sendDelayUs;
+	uint8_t midiBuf[TUNING_MAX_PACKET_MESSAGES * (sizeof(UMPMessage) + 8)]; // For multi-message sending, with timestamps and play times
+
+	std::atomic<int> m_maxSeqNo;
+	std::atomic<int> m_hbCount;
+
+	std::thread heartbeatProbe;
+	std::thread failoverProbe;
+	std::mutex m_stopMutex;
+	std::condition_variable m_stopWake;
+	bool m_stopping;
+	int heartbeatNonce;
+
+	// Primary and standby playback modules, and the one in use
+	std::vector<PlaybackTarget> m_targets;
+	std::atomic<size_t> m_active;
+	std::atomic<int> m_probeMisses;
+
+	// First packet the active module has not played yet
+	std::atomic<int> m_playedSeqNo;
+
+	// Recently sent packets and the highest sequence number sent
+	std::deque<std::shared_ptr<ndn::Data> > m_sentCache;
+	std::mutex m_sentMutex;
+	std::atomic<int> m_lastSentSeqNo;
+
+	// Highest cumulative ack received, -1 before the first
+	std::atomic<int> m_ackedSeqNo;
+	std::atomic<unsigned long> m_sentMessages;
+	ControllerState m_state;
+
+	std::shared_ptr<const Tuning> m_tuning;
+
+	// Id of our short data names
+	uint64_t m_streamId;
+
+	// Playback module clock minus local clock
+	std::atomic<int64_t> m_clockOffsetUs;
+
+	// Status bytes the playback module drops, bit per status byte
+	std::atomic<uint32_t> m_dropStatus[8];
+
+	std::function<void(uint64_t)> m_onPublish;
+	std::atomic<int> m_lastPublished;
+
+public:
+	//add RtMidiIn instance to the class
+	MidiInput *midiin;
+};
+
+// Send queued input whenever an interest is waiting, waiting for more
+// of either as set with getSendWait()
+inline void
+output_sender(Controller& controller)
+{
+	WaitStrategy& wakeup = controller.getSendWait();
+	while (true)
+	{
+		uint32_t ticket = wakeup.prepare();
+		if (!controller.replyInterest())
+		{
+			wakeup.wait(ticket, controller.getSendDelayUs());
+		}
+	}
+}
+
+
+// MIDI input port buffering queueSize messages
+inline MidiInput*
+newMidiInput(unsigned int queueSize)
+{
+#if defined(RTMIDI_SINGLE_BACKEND)
+	return new MidiInput("RtMidi Input Client", queueSize);
+#else
+	return new MidiInput(RtMidi::UNSPECIFIED, "RtMidi Input Client", queueSize);
+#endif
+}
+
+
+// Non-blocking function to get MIDI messages
+// Messages are also written to record if given (see loadRecording)
+// An idle port is polled continuously or every MIDI_POLL_US, as
+// waitMode says
+inline void
+midiLoopNoBlock(MidiInput *midiin, std::vector<unsigned char> message, Controller& controller,
+				std::ostream *record, WaitMode waitMode = WAIT_SPIN_PARK)
+{
+	WaitStrategy idle(waitMode);
+	uint64_t lastMessageNs = WaitStrategy::nowNs();
+	bool done = false;
+	double stamp;
+	int nBytes;
+	while ( !done ) {
+    	stamp = midiin->getMessage( &message );
+    	nBytes = message.size();
+		if ( nBytes == 0 ) {
+			idle.idle(WaitStrategy::nowNs() - lastMessageNs, MIDI_POLL_US);
+			continue;
+		}
+		lastMessageNs = WaitStrategy::nowNs();
+		NDNMIDI_TRACE3(capture, umpClockMicros(), nBytes, message[0]);
+    	// for (int i=0; i<nBytes; i++ ){
+     //  		std::cout << "Byte " << i << " = " << (unsigned char)message[i] << ", ";
+     //  	}
+    	if ( nBytes > 0 ){
+      		// Translated to UMP on the way into the queue
+      		controller.addInput(&message[0], nBytes);
+			if (record)
+			{
+				*record << std::fixed << std::setprecision(6) << stamp << std::hex;
+				for (int i = 0; i < nBytes; i++)
+				{
+					*record << " " << (int)message[i];
+				}
+				*record << std::dec << std::endl;
+			}
+		}
+	}
+}
+
+
+// Load generator: feeds the controller notesPerSecond notes, each with a
+// pitch bend and the previous note's note off, instead of a MIDI port
+inline void
+syntheticInput(Controller& controller, unsigned int notesPerSecond)
+{
+	unsigned char note = 60;
+	for (unsigned int i = 0; ; ++i)
+	{
+		unsigned char noteOff[3] = {0x80, note, 0};
+		controller.addInput(noteOff, 3);
+		note = 48 + i % 24;
+		unsigned char noteOn[3] = {0x90, note, (unsigned char)(64 + i % 64)};
+		controller.addInput(noteOn, 3);
+		unsigned char bend[3] = {0xE0, 0, (unsigned char)(i % 128)};
+		controller.addInput(bend, 3);
+		std::this_thread::sleep_for(std::chrono::microseconds(1000000 / notesPerSecond));
+	}
+}
+
+
+// A recorded input message and the time since the previous one
+struct RecordedMessage
+{
+	double deltaS;
+	std::vector<unsigned char> bytes;
+};
+
+// Read a recording written by midiLoopNoBlock: one message per line,
+// the seconds since the previous message followed by its bytes in hex
+inline bool
+loadRecording(const std::string& fileName, std::vector<RecordedMessage>& messages)
+{
+	std::ifstream file(fileName.c_str());
+	if (!file)
+	{
+		std::cerr << "Could not open recording: " << fileName << std::endl;
+		return false;
+	}
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream fields(line);
+		RecordedMessage recorded;
+		unsigned int byte;
+		if (!(fields >> recorded.deltaS))
+		{
+			continue;
+		}
+		while (fields >> std::hex >> byte)
+		{
+			recorded.bytes.push_back(byte);
+		}
+		if (!recorded.bytes.empty())
+		{
+			messages.push_back(recorded);
+		}
+	}
+	if (messages.empty())
+	{
+		std::cerr << "Recording has no messages: " << fileName << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Load generator: feeds the controller a recording, over and over,
+// with its original timing
+inline void
+recordedInput(Controller& controller, const std::vector<RecordedMessage>& messages)
+{
+	while (true)
+	{
+		for (const RecordedMessage& recorded : messages)
+		{
+			std::this_thread::sleep_for(std::chrono::duration<double>(recorded.deltaS));
+			controller.addInput(recorded.bytes.data(), recorded.bytes.size());
+		}
+	}
+}
+
+
+// Sequenced input: plays a recording, over and over, leadS seconds
+// ahead of time. Every LOOKAHEAD_CHUNK_MS, the events due within the
+// lead are queued with their play times
+inline void
+lookaheadInput(Controller& controller, const std::vector<RecordedMessage>& messages, double leadS)
+{
+	double lengthS = 0;
+	for (const RecordedMessage& recorded : messages)
+	{
+		lengthS += recorded.deltaS;
+	}
+	if (lengthS <= 0)
+	{
+		std::cerr << "Recording has no duration to play ahead" << std::endl;
+		return;
+	}
+	uint64_t leadUs = std::min<uint64_t>(std::max(leadS, 0.0) * 1000000, UMP_PLAY_AT_MAX_US);
+	uint64_t playUs = umpClockMicros() + leadUs;
+	size_t next = 0;
+	while (true)
+	{
+		uint64_t horizonUs = umpClockMicros() + leadUs;
+		// The delta of the first message separates repetitions
+		while (playUs + (uint64_t)(messages[next].deltaS * 1000000) <= horizonUs)
+		{
+			const RecordedMessage& recorded = messages[next];
+			playUs += recorded.deltaS * 1000000;
+			controller.addScheduledInput(recorded.bytes.data(), recorded.bytes.size(), playUs);
+			next = (next + 1) % messages.size();
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(LOOKAHEAD_CHUNK_MS));
+	}
+}
+
+
+// This function should be embedded in a try/catch block in case of
+// an exception.  It offers the user a choice of MIDI ports to open.
+// It returns false if there are no ports available.
+inline bool
+chooseMidiPort( MidiInput *rtmidi )
+{
+
+   std::cout << "\nWould you like to open a virtual NDN-MIDI input port? [y/N] ";
+
+  std::string keyHit;
+  std::getline( std::cin, keyHit );
+  if ( keyHit == "y" ) {
+    rtmidi->openVirtualPort();
+    return true;
+  }
+  
+
+  std::string portName;
+  unsigned int i = 0, nPorts = rtmidi->getPortCount();
+  if ( nPorts == 0 )
+  {
+    std::cout << "No input ports available!" << std::endl;
+    return false;
+  }
+  if ( nPorts == 1 )
+  {
+    std::cout << "\nOpening " << rtmidi->getPortName() << std::endl;
+  }
+  else
+  {
+    for ( i=0; i<nPorts; i++ )
+    {
+      portName = rtmidi->getPortName(i);
+      std::cout << "  Input port #" << i << ": " << portName << '\n';
+    }
+
+    do
+    {
+      std::cout << "\nChoose a port number: ";
+      std::cin >> i;
+    } while ( i >= nPorts );
+    std::getline( std::cin, keyHit );  // used to clear out stdin
+  }
+
+  rtmidi->openPort( i );
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,491 @@
+/********************************
+
+EventTransform.h
+
+Per-player event transforms for PlaybackModuleMIDI
+
+A transforms file configures what happens to each player's events:
+
+  # comment
+  player alice            following lines apply to alice
+  transpose -12           shift notes, notes pushed out of range are dropped
+  velocity curve 0.6      v' = 127 * (v / 127) ^ 0.6
+  velocity range 40 110   map velocities 1..127 onto 40..110
+  velocity fixed 100      every note on at 100
+  zone 0 59 2             notes 0-59 (after transposition) to channel 2
+  filter aftertouch cc 1  drop channel and poly pressure and CC 1
+
+  player *                everyone without a section of their own
+
+Lines before the first "player" line also apply to everyone else.
+Filter names: noteoff noteon polypressure controlchange programchange
+channelpressure pitchbend aftertouch (both pressures) cc <n> timecode
+songposition songselect tunerequest clock start continue stop
+activesensing reset realtime (clock to reset).
+
+Each player's rules compile to 128-entry note, channel and velocity
+tables plus bitmaps of dropped status bytes and controllers, applied
+to a whole decoded packet in one pass. Zones only move notes, poly
+pressure and MIDI 2.0 per-note messages; other channel messages stay on
+the connection's channel.
+Velocity tables only apply to MIDI 1.0 note ons.
+
+Like access rules, a compiled set is immutable and swapped in
+atomically on reload.
+
+********************************/
+
+#ifndef NDNMIDI_EVENT_TRANSFORM_H
+#define NDNMIDI_EVENT_TRANSFORM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#include "UniversalMidiPacket.h"
+
+// Entry of noteMap for a dropped note, of noteChannel for no zone
+#define TRANSFORM_DROP_NOTE 0x80
+#define TRANSFORM_NO_ZONE 0xFF
+
+// Tables for the events of one player
+struct CompiledTransform
+{
+	uint8_t noteMap[128];
+	uint8_t noteChannel[128];
+	uint8_t velocityMap[128];
+	uint32_t dropStatus[8];			// bit per status byte
+	uint32_t dropController[4];		// bit per controller number
+	bool identity;
+
+	CompiledTransform()
+		: identity(true)
+	{
+		for (int i = 0; i < 128; i++)
+		{
+			noteMap[i] = i;
+			noteChannel[i] = TRANSFORM_NO_ZONE;
+			velocityMap[i] = i;
+		}
+		memset(dropStatus, 0, sizeof(dropStatus));
+		memset(dropController, 0, sizeof(dropController));
+	}
+
+	bool
+	dropsStatus(unsigned int status) const
+	{
+		return (dropStatus[status >> 5] >> (status & 31)) & 1;
+	}
+
+	bool
+	dropsController(unsigned int controller) const
+	{
+		return (dropController[controller >> 5] >> (controller & 31)) & 1;
+	}
+
+	// Whether bits 8-14 of a channel voice message hold a note number;
+	// in other MIDI 2.0 messages below 0x80 (e.g. RPN) they hold a bank
+	static bool
+	carriesNote(unsigned int type, unsigned int status)
+	{
+		switch (status & 0xF0)
+		{
+			case 0x80: case 0x90: case 0xA0:
+				return true;
+			// Per-note controllers, per-note pitch bend and management
+			case 0x00: case 0x10: case 0x60: case 0xF0:
+				return type == UMP_TYPE_MIDI2_VOICE;
+			default:
+				return false;
+		}
+	}
+
+	// Transform the host-order UMP messages in words in place and remove
+	// the dropped ones; messages are single words unless irregular
+	// Returns the new number of words
+	size_t
+	apply(uint32_t *words, size_t count, bool irregular) const
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < count; )
+		{
+			uint32_t word = words[i];
+			unsigned int type = umpType(word);
+			unsigned int msgWords = irregular ? umpWordCount(word) : 1;
+			if (i + msgWords > count)
+			{
+				break;
+			}
+
+			bool keep = true;
+			if (type == UMP_TYPE_SYSTEM || type == UMP_TYPE_MIDI1_VOICE || type == UMP_TYPE_MIDI2_VOICE)
+			{
+				unsigned int status = umpStatus(word);
+				unsigned int index = (word >> 8) & 0x7F;
+				if (dropsStatus(status))
+				{
+					keep = false;
+				}
+				else if (type != UMP_TYPE_SYSTEM && carriesNote(type, status))
+				{
+					// Note off, note on, poly pressure and MIDI 2.0 per-note
+					// messages
+					uint8_t note = noteMap[index];
+					if (note & TRANSFORM_DROP_NOTE)
+					{
+						keep = false;
+					}
+					word = (word & 0xFFFF80FFu) | ((uint32_t)note << 8);
+					if (noteChannel[index] != TRANSFORM_NO_ZONE)
+					{
+						word = umpSetChannel(word, noteChannel[index]);
+					}
+					if (type == UMP_TYPE_MIDI1_VOICE && (status & 0xF0) == 0x90)
+					{
+						word = (word & 0xFFFFFF80u) | velocityMap[word & 0x7F];
+					}
+				}
+				else if (type != UMP_TYPE_SYSTEM && (status & 0xF0) == 0xB0 && dropsController(index))
+				{
+					keep = false;
+				}
+			}
+
+			if (keep)
+			{
+				words[kept] = word;
+				for (unsigned int j = 1; j < msgWords; ++j)
+				{
+					words[kept + j] = words[i + j];
+				}
+				kept += msgWords;
+			}
+			i += msgWords;
+		}
+		return kept;
+	}
+
+	// Dropped status bytes as 64 hex digits, for the handshake
+	std::string
+	statusFilterHex() const
+	{
+		std::ostringstream hex;
+		hex << std::hex;
+		for (int i = 0; i < 8; i++)
+		{
+			hex.width(8);
+			hex.fill('0');
+			hex << dropStatus[i];
+		}
+		return hex.str();
+	}
+};
+
+// Parse the status filter of a handshake into bitmap
+// Returns false if text is not a status filter
+inline bool
+parseStatusFilterHex(const std::string& text, uint32_t *bitmap)
+{
+	if (text.size() != 64)
+	{
+		return false;
+	}
+	for (int i = 0; i < 8; i++)
+	{
+		char *end;
+		std::string group = text.substr(8 * i, 8);
+		bitmap[i] = strtoul(group.c_str(), &end, 16);
+		if (*end != '\0')
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Holds the active transforms and replaces them atomically
+class EventTransforms
+{
+public:
+	EventTransforms()
+		: m_current(std::make_shared<TransformSet>())
+	{
+	}
+
+	// Tables for player, shared by everyone without rules of their own
+	std::shared_ptr<const CompiledTransform>
+	get(const std::string& player) const
+	{
+		std::shared_ptr<const TransformSet> current = std::atomic_load(&m_current);
+		std::map<std::string, std::shared_ptr<const CompiledTransform> >::const_iterator it = current->players.find(player);
+		return it != current->players.end() ? it->second : current->defaults;
+	}
+
+	// Replace the transforms with the contents of fileName
+	// The current transforms are kept if the file cannot be parsed
+	bool
+	loadFile(const std::string& fileName)
+	{
+		std::ifstream file(fileName);
+		if (!file)
+		{
+			std::cerr << "Could not open transforms: " << fileName << std::endl;
+			return false;
+		}
+
+		std::map<std::string, std::shared_ptr<CompiledTransform> > players;
+		players["*"] = std::make_shared<CompiledTransform>();
+		std::shared_ptr<CompiledTransform> section = players["*"];
+		int transpose = 0;
+		std::string line;
+		int lineNo = 0;
+		while (std::getline(file, line))
+		{
+			++lineNo;
+			std::istringstream words(line);
+			std::string keyword;
+			if (!(words >> keyword) || keyword[0] == '#')
+			{
+				continue;
+			}
+
+			bool ok = true;
+			if (keyword == "player")
+			{
+				std::string player;
+				ok = (bool)(words >> player);
+				if (ok)
+				{
+					if (players.count(player) == 0)
+					{
+						players[player] = std::make_shared<CompiledTransform>();
+					}
+					section = players[player];
+					transpose = 0;
+				}
+			}
+			else if (keyword == "transpose")
+			{
+				ok = (bool)(words >> transpose);
+				for (int note = 0; note < 128; note++)
+				{
+					int moved = note + transpose;
+					section->noteMap[note] = (moved < 0 || moved > 127) ? TRANSFORM_DROP_NOTE : moved;
+				}
+			}
+			else if (keyword == "velocity")
+			{
+				ok = parseVelocity(words, section->velocityMap);
+			}
+			else if (keyword == "zone")
+			{
+				int low, high, channel;
+				ok = (words >> low >> high >> channel) && low >= 0 && high <= 127 && low <= high
+					&& channel >= 1 && channel <= 16;
+				// Zones select by the note that will be played
+				for (int note = 0; ok && note < 128; note++)
+				{
+					int moved = note + transpose;
+					if (moved >= low && moved <= high)
+					{
+						section->noteChannel[note] = channel - 1;
+					}
+				}
+			}
+			else if (keyword == "filter")
+			{
+				std::string name;
+				while (ok && words >> name)
+				{
+					ok = parseFilter(name, words, *section);
+				}
+			}
+			else
+			{
+				ok = false;
+			}
+
+			if (!ok)
+			{
+				std::cerr << fileName << ":" << lineNo << ": cannot parse \"" << line << "\"" << std::endl;
+				return false;
+			}
+			if (keyword != "player")
+			{
+				section->identity = false;
+			}
+		}
+
+		std::shared_ptr<TransformSet> compiled = std::make_shared<TransformSet>();
+		for (std::pair<const std::string, std::shared_ptr<CompiledTransform> >& entry : players)
+		{
+			if (entry.first == "*")
+			{
+				compiled->defaults = entry.second;
+			}
+			else
+			{
+				compiled->players[entry.first] = entry.second;
+			}
+		}
+		std::lock_guard<std::mutex> lock(m_writeMutex);
+		std::atomic_store(&m_current, std::shared_ptr<const TransformSet>(compiled));
+		m_fileName = fileName;
+		return true;
+	}
+
+	// Reload the last file given to loadFile()
+	bool
+	reload()
+	{
+		if (m_fileName.empty())
+		{
+			return false;
+		}
+		return loadFile(m_fileName);
+	}
+
+private:
+	struct TransformSet
+	{
+		TransformSet()
+			: defaults(std::make_shared<CompiledTransform>())
+		{
+		}
+
+		std::map<std::string, std::shared_ptr<const CompiledTransform> > players;
+		std::shared_ptr<const CompiledTransform> defaults;
+	};
+
+	static bool
+	parseVelocity(std::istringstream& words, uint8_t *velocityMap)
+	{
+		std::string kind;
+		words >> kind;
+		double a, b = 0;
+		if (kind == "curve")
+		{
+			if (!(words >> a) || a <= 0)
+			{
+				return false;
+			}
+		}
+		else if (kind == "range")
+		{
+			if (!(words >> a >> b) || a < 1 || b > 127 || a > b)
+			{
+				return false;
+			}
+		}
+		else if (kind == "fixed")
+		{
+			if (!(words >> a) || a < 1 || a > 127)
+			{
+				return false;
+			}
+		}
+		else
+		{
+			return false;
+		}
+
+		// Velocity 0 stays a note off
+		velocityMap[0] = 0;
+		for (int v = 1; v < 128; v++)
+		{
+			double mapped;
+			if (kind == "curve")
+			{
+				mapped = 127 * pow(v / 127.0, a);
+			}
+			else if (kind == "range")
+			{
+				mapped = a + (b - a) * (v - 1) / 126.0;
+			}
+			else
+			{
+				mapped = a;
+			}
+			int rounded = (int)(mapped + 0.5);
+			velocityMap[v] = rounded < 1 ? 1 : (rounded > 127 ? 127 : rounded);
+		}
+		return true;
+	}
+
+	static void
+	dropChannelType(CompiledTransform& transform, unsigned int type)
+	{
+		for (unsigned int status = type; status < type + 16; status++)
+		{
+			transform.dropStatus[status >> 5] |= 1u << (status & 31);
+		}
+	}
+
+	static void
+	dropSystem(CompiledTransform& transform, unsigned int status)
+	{
+		transform.dropStatus[status >> 5] |= 1u << (status & 31);
+	}
+
+	static bool
+	parseFilter(const std::string& name, std::istringstream& words, CompiledTransform& transform)
+	{
+		static const std::map<std::string, unsigned int> channelTypes = {
+			{"noteoff", 0x80}, {"noteon", 0x90}, {"polypressure", 0xA0}, {"controlchange", 0xB0},
+			{"programchange", 0xC0}, {"channelpressure", 0xD0}, {"pitchbend", 0xE0}};
+		static const std::map<std::string, unsigned int> systemTypes = {
+			{"timecode", 0xF1}, {"songposition", 0xF2}, {"songselect", 0xF3}, {"tunerequest", 0xF6},
+			{"clock", 0xF8}, {"start", 0xFA}, {"continue", 0xFB}, {"stop", 0xFC},
+			{"activesensing", 0xFE}, {"reset", 0xFF}};
+
+		if (channelTypes.count(name))
+		{
+			dropChannelType(transform, channelTypes.at(name));
+		}
+		else if (systemTypes.count(name))
+		{
+			dropSystem(transform, systemTypes.at(name));
+		}
+		else if (name == "aftertouch")
+		{
+			dropChannelType(transform, 0xA0);
+			dropChannelType(transform, 0xD0);
+		}
+		else if (name == "realtime")
+		{
+			for (unsigned int status = 0xF8; status <= 0xFF; status++)
+			{
+				dropSystem(transform, status);
+			}
+		}
+		else if (name == "cc")
+		{
+			int controller;
+			if (!(words >> controller) || controller < 0 || controller > 127)
+			{
+				return false;
+			}
+			transform.dropController[controller >> 5] |= 1u << (controller & 31);
+		}
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+
+	std::shared_ptr<const TransformSet> m_current;
+	std::mutex m_writeMutex;
+	std::string m_fileName;
+};
+
+#endif
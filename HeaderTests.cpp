@@ -0,0 +1,318 @@
+/********************************
+
+HeaderTests.cpp (header-tests)
+Needs only the standard library: run with make test
+
+Checks of the header-only building blocks that do not need a forwarder
+or a MIDI port: UMP conversions, the batch packet decoders against the
+scalar one, LatencyHistogram bucket bounds, the access rule matcher and
+the transforms file parser. Prints every failed check and exits with
+the number of failures.
+
+********************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "UniversalMidiPacket.h"
+#include "BatchDecode.h"
+#include "LatencyHistogram.h"
+#include "AccessControl.h"
+#include "EventTransform.h"
+
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { if (!(condition)) { ++failures; std::cerr << __FILE__ << ":" << __LINE__ << ": " #condition << std::endl; } } while (0)
+
+// Every MIDI 1.0 message the applications carry survives the trip
+// through UMP, and the utility words keep their times
+static void
+testUmpConversions()
+{
+	for (unsigned int status = 0x80; status <= 0xFF; ++status)
+	{
+		int dataLength = midi1DataLength(status);
+		unsigned char bytes[3] = {(unsigned char)status, 0x3C, 0x7F};
+		UMPMessage msg = {{0, 0, 0, 0}};
+		if (dataLength < 0)
+		{
+			CHECK(!midi1ToUMP(bytes, 3, 0, msg));
+			continue;
+		}
+		CHECK(midi1ToUMP(bytes, dataLength + 1, 0, msg));
+		CHECK(umpWordCount(msg.word[0]) == 1);
+		CHECK(umpStatus(msg.word[0]) == status);
+
+		unsigned char back[3] = {0, 0, 0};
+		CHECK(umpToMIDI1(msg.word, back) == (size_t)dataLength + 1);
+		for (int i = 0; i <= dataLength; ++i)
+		{
+			CHECK(back[i] == bytes[i]);
+		}
+	}
+
+	// Running status and truncated messages are refused
+	unsigned char data[2] = {0x3C, 0x40};
+	unsigned char shortNote[2] = {0x90, 0x3C};
+	UMPMessage msg;
+	CHECK(!midi1ToUMP(data, 2, 0, msg));
+	CHECK(!midi1ToUMP(shortNote, 2, 0, msg));
+
+	// MIDI 2.0 note on scaled down, never to velocity 0
+	uint32_t noteOn[2] = {0x40903C00u, 0x00010000u};
+	unsigned char out[3];
+	CHECK(umpToMIDI1(noteOn, out) == 3);
+	CHECK(out[0] == 0x90 && out[1] == 0x3C && out[2] == 1);
+
+	uint8_t wire[4];
+	umpWrite(0x20903C7Fu, wire);
+	CHECK(wire[0] == 0x20 && wire[3] == 0x7F);
+	CHECK(umpRead(wire) == 0x20903C7Fu);
+
+	// A JR timestamp resolves to its tick however the clock has wrapped
+	uint64_t nowUs = 5 * UMP_JR_PERIOD_US + 12345;
+	for (uint64_t ageUs = 0; ageUs < UMP_JR_PERIOD_US / 2; ageUs += 9973)
+	{
+		uint64_t stampUs = nowUs - ageUs;
+		uint32_t word = umpJRTimestamp(stampUs);
+		CHECK(umpIsJRTimestamp(word));
+		CHECK(umpJRTimestampTime(word, nowUs) == stampUs / UMP_JR_TICK_US * UMP_JR_TICK_US);
+	}
+
+	// Play-At leads keep their ticks and are clamped to the field
+	uint32_t playAt = umpPlayAt(1000000);
+	CHECK(umpIsPlayAt(playAt) && !umpIsJRTimestamp(playAt));
+	CHECK(umpPlayAtLeadUs(playAt) == 1000000 / UMP_JR_TICK_US * UMP_JR_TICK_US);
+	CHECK(umpPlayAtLeadUs(umpPlayAt(UMP_PLAY_AT_MAX_US + 1000)) == UMP_PLAY_AT_MAX_US / UMP_JR_TICK_US * UMP_JR_TICK_US);
+}
+
+// Compare decoder with the scalar decoder on packet, and with the
+// message by message walk when the packet is irregular
+static void
+checkDecoder(BatchDecodeFn decoder, const std::vector<uint32_t>& packet)
+{
+	std::vector<uint8_t> wire(packet.size() * 4);
+	for (size_t i = 0; i < packet.size(); ++i)
+	{
+		umpWrite(packet[i], &wire[4 * i]);
+	}
+	std::vector<uint32_t> expected(packet.size());
+	std::vector<uint32_t> decoded(packet.size());
+	unsigned int expectedFlags = batchDecodeScalar(wire.data(), packet.size(), 5, expected.data());
+	unsigned int flags = decoder(wire.data(), packet.size(), 5, decoded.data());
+	CHECK(flags == expectedFlags);
+	if (!(flags & BATCH_IRREGULAR))
+	{
+		CHECK(decoded == expected);
+		return;
+	}
+
+	// Only message heads can be shutdown markers
+	std::vector<uint32_t> messages(packet.size());
+	flags = batchDecodeMessages(wire.data(), packet.size(), 5, messages.data());
+	bool shutdown = false;
+	for (size_t i = 0; i < packet.size(); i += umpWordCount(packet[i]))
+	{
+		shutdown = shutdown || packet[i] == UMP_SHUTDOWN;
+		CHECK(messages[i] == umpSetChannel(packet[i], 5));
+		for (size_t j = 1; j < umpWordCount(packet[i]) && i + j < packet.size(); ++j)
+		{
+			CHECK(messages[i + j] == packet[i + j]);
+		}
+	}
+	CHECK(flags == (BATCH_IRREGULAR | (shutdown ? BATCH_SHUTDOWN : 0)));
+}
+
+static void
+testBatchDecode()
+{
+	std::vector<BatchDecodeFn> decoders;
+	decoders.push_back(selectBatchDecoder());
+#ifdef NDNMIDI_BATCH_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("ssse3"))
+	{
+		decoders.push_back(batchDecodeSSSE3);
+	}
+	if (__builtin_cpu_supports("avx2"))
+	{
+		decoders.push_back(batchDecodeAVX2);
+	}
+#endif
+
+	// Channel voice, system, JR timestamps, shutdown and two-word MIDI
+	// 2.0 messages in packets of every length around the vector widths
+	const uint32_t words[] = {0x20913C7Fu, 0x20804000u, 0x20B00764u, 0x20C50500u, 0x10F80000u,
+							  0x10F23412u, umpJRTimestamp(123456), UMP_SHUTDOWN, 0x40903C00u, 0x40B00700u};
+	srand(7);
+	for (size_t length = 0; length < 40; ++length)
+	{
+		for (int round = 0; round < 50; ++round)
+		{
+			std::vector<uint32_t> packet;
+			bool regular = round % 2 == 0;
+			while (packet.size() < length)
+			{
+				uint32_t word = words[rand() % (regular ? 8 : 10)];
+				packet.push_back(word);
+				if (umpType(word) == UMP_TYPE_MIDI2_VOICE)
+				{
+					packet.push_back(rand() % 2 ? 0x80000000u : 0);
+				}
+			}
+			for (size_t i = 0; i < decoders.size(); ++i)
+			{
+				checkDecoder(decoders[i], packet);
+			}
+		}
+	}
+}
+
+// A percentile is the upper bound of the bucket holding the sample:
+// the value itself below 64 us, within 1/32 of it above
+static void
+testLatencyHistogram()
+{
+	for (uint64_t value = 0; value <= LATENCY_MAX_US; value = value < 256 ? value + 1 : value * 17 / 16)
+	{
+		LatencyHistogram histogram;
+		histogram.record(value);
+		histogram.record(LATENCY_MAX_US);
+		uint64_t bound = histogram.getPercentile(50);
+		CHECK(bound >= value);
+		CHECK(value < 2 * LATENCY_SUB_BUCKETS ? bound == value : bound - value <= value / LATENCY_SUB_BUCKETS);
+		CHECK(histogram.getPercentile(100) == LATENCY_MAX_US);
+	}
+
+	LatencyHistogram histogram;
+	CHECK(histogram.getCount() == 0 && histogram.getPercentile(99) == 0);
+	for (uint64_t value = 1; value <= 100; ++value)
+	{
+		histogram.record(value * 10);
+	}
+	histogram.record(LATENCY_MAX_US * 2);
+	CHECK(histogram.getCount() == 101);
+	CHECK(histogram.getMax() == LATENCY_MAX_US);
+	uint64_t p50 = histogram.getPercentile(50);
+	CHECK(p50 >= 500 && p50 <= 500 + 500 / LATENCY_SUB_BUCKETS);
+
+	// An interval measured against a snapshot ignores earlier samples
+	LatencySnapshot start = histogram.snapshot();
+	CHECK(histogram.getCountSince(start) == 0 && histogram.getPercentileSince(start, 50) == 0);
+	for (int i = 0; i < 10; ++i)
+	{
+		histogram.record(40);
+	}
+	CHECK(histogram.getCountSince(start) == 10);
+	CHECK(histogram.getPercentileSince(start, 50) == 40);
+	CHECK(histogram.getPercentileSince(start, 100) == 40);
+}
+
+static void
+testAccessControl()
+{
+	std::vector<AclRule> rules;
+	rules.push_back({true, "alice"});
+	rules.push_back({true, "studio-*"});
+	rules.push_back({true, "room?-piano"});
+	rules.push_back({false, "studio-guest"});
+	rules.push_back({false, "*-test"});
+	CompiledAcl acl(rules);
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		// The second pass is answered from the verdict cache
+		CHECK(acl.check("alice") == ACL_ALLOWED);
+		CHECK(acl.check("alicia") == ACL_NOT_ALLOWED);
+		CHECK(acl.check("studio-") == ACL_ALLOWED);
+		CHECK(acl.check("studio-b") == ACL_ALLOWED);
+		CHECK(acl.check("studio-guest") == ACL_PROHIBITED);
+		CHECK(acl.check("studio-test") == ACL_PROHIBITED);
+		CHECK(acl.check("room1-piano") == ACL_ALLOWED);
+		CHECK(acl.check("room12-piano") == ACL_NOT_ALLOWED);
+		CHECK(acl.check("bob") == ACL_NOT_ALLOWED);
+	}
+
+	std::vector<AclRule> denyOnly;
+	denyOnly.push_back({false, "eve*"});
+	CompiledAcl open(denyOnly);
+	CHECK(open.check("bob") == ACL_ALLOWED);
+	CHECK(open.check("eve") == ACL_PROHIBITED);
+	CHECK(open.check("evelyn") == ACL_PROHIBITED);
+}
+
+static void
+testTransforms()
+{
+	std::string fileName = "header-tests.transforms";
+	{
+		std::ofstream file(fileName.c_str());
+		file << "# everyone\n"
+			 << "filter clock\n"
+			 << "player alice\n"
+			 << "transpose -12\n"
+			 << "velocity fixed 100\n"
+			 << "zone 0 59 2\n"
+			 << "filter cc 1\n";
+	}
+	EventTransforms transforms;
+	CHECK(transforms.loadFile(fileName));
+
+	std::shared_ptr<const CompiledTransform> others = transforms.get("bob");
+	CHECK(others->dropsStatus(0xF8) && !others->dropsStatus(0x90));
+	CHECK(others->noteMap[60] == 60);
+
+	std::shared_ptr<const CompiledTransform> alice = transforms.get("alice");
+	CHECK(!alice->identity);
+	CHECK(alice->noteMap[60] == 48 && alice->noteMap[5] == TRANSFORM_DROP_NOTE);
+	CHECK(alice->dropsController(1) && !alice->dropsController(7));
+
+	// Note on 72 -> 60 on the connection's channel, note on 60 -> 48 in
+	// the zone on channel 2, note 5 and CC 1 dropped
+	uint32_t words[] = {0x20904840u, 0x20903C40u, 0x20900540u, 0x20B00140u, 0x20B00740u};
+	size_t kept = alice->apply(words, 5, false);
+	CHECK(kept == 3);
+	CHECK(words[0] == 0x20903C64u);
+	CHECK(words[1] == 0x20913064u);
+	CHECK(words[2] == 0x20B00740u);
+
+	// MIDI 2.0 per-note messages are moved, registered controllers are not
+	uint32_t midi2[] = {0x40004810u, 0x12345678u, 0x40200102u, 0x12345678u};
+	CHECK(alice->apply(midi2, 4, true) == 4);
+	CHECK(midi2[0] == 0x40003C10u && midi2[2] == 0x40200102u);
+
+	// A bad line keeps the rules loaded before
+	{
+		std::ofstream file(fileName.c_str());
+		file << "player alice\ntranspose up\n";
+	}
+	CHECK(!transforms.loadFile(fileName));
+	CHECK(transforms.get("alice")->noteMap[60] == 48);
+	remove(fileName.c_str());
+}
+
+int
+main()
+{
+	testUmpConversions();
+	testBatchDecode();
+	testLatencyHistogram();
+	testAccessControl();
+	testTransforms();
+
+	if (failures > 0)
+	{
+		std::cerr << failures << " checks failed" << std::endl;
+	}
+	else
+	{
+		std::cout << "All header checks passed" << std::endl;
+	}
+	return failures;
+}
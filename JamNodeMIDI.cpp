@@ -0,0 +1,758 @@
+/********************************
+
+JamNodeMIDI.cpp (midi-ndn-node)
+Requires NFD, ndn-cxx, RtMidi.cpp, and RtMidi.h to compile
+
+Full-duplex jam node: a Controller and a PlaybackModule in one process
+
+Publishes local MIDI input to a remote playback module and plays back
+the streams of remote controllers, sharing one Face, one prefix
+registration and one housekeeping thread for heartbeats and
+connection monitoring. Each half signs with its own KeyChain, as the
+Controller signs on its send thread and the PlaybackModule on the
+face thread. Both halves run on the same event loop and clock.
+
+With --group the node joins a group session instead: every member
+publishes its stream once and plays the streams of all other members,
+which it discovers through state-vector sync (see StateVectorSync.h).
+
+With --soak the node runs a soak test against itself (or --remote):
+synthetic input at --soak-rate notes per second, all connections
+dropped every SOAK_CHURN_PERIOD_S, and heartbeat and monitoring timers
+running --soak-speed times faster than normal. Memory, CPU, pending
+Interests and queue depths are sampled every SOAK_SAMPLE_PERIOD_S, and
+after --soak seconds the node exits with status 1 if any of them grew.
+
+With --autotune the node plays synthetic or recorded input to itself
+while sweeping the packet size, the Interest window and the heartbeat
+period one at a time, each trial measuring latency and CPU use, and
+writes the best settings found to a tuning file (see Tuning.h).
+
+With --bench-writes the node plays synthetic input to itself for the
+given number of seconds and reports how many socket writes its Face
+made to the forwarder per MIDI event sent, with or without
+--batch-writes (see BatchingTransport.h).
+
+With --bench-wait the node measures the wake-up latency and CPU cost
+of each wait strategy of its pipeline threads (see WaitStrategy.h) and
+exits. --wait, or --capture-wait and --send-wait, choose them.
+
+With --play the node streams a recording instead of its MIDI input,
+and with --lookahead it streams it seconds ahead of time for the
+playback module to play on schedule (see ControllerMIDI.h).
+
+********************************/
+
+#include "ControllerMIDI.h"
+#include "PlaybackModuleMIDI.h"
+#include "StateVectorSync.h"
+#include "ResourceMonitor.h"
+#include "BatchingTransport.h"
+#include "WaitStrategy.h"
+#include "Options.h"
+#include "Tuning.h"
+
+#include <future>
+
+// Interval in seconds of (accelerated) soak time between dropping all connections
+#define SOAK_CHURN_PERIOD_S 60
+
+// Interval in seconds between soak resource samples
+#define SOAK_SAMPLE_PERIOD_S 10
+
+// Default length in seconds of an autotune trial
+#define AUTOTUNE_TRIAL_S 10
+
+// Seconds at the start of an autotune trial left out while it settles
+#define AUTOTUNE_SETTLE_S 2
+
+// Trials whose p99 latency is within this fraction of the best one's
+// count as equally fast, and the one using the least CPU wins
+#define AUTOTUNE_LATENCY_TOLERANCE 0.05
+
+// CPU use, in percent of a core, within which heartbeat periods count
+// as equally cheap, and the shortest wins
+#define AUTOTUNE_CPU_TOLERANCE 0.5
+
+// Default length in seconds of a --bench-writes run
+#define BENCH_WRITES_S 30
+
+// Default length in seconds of each strategy's --bench-wait run, and
+// notifications per second
+#define BENCH_WAIT_S 5
+#define BENCH_WAIT_RATE 1000
+
+// Values tried by --autotune
+static const unsigned int AUTOTUNE_PACKET_MESSAGES[] = {1, 2, 5, 10, 20, 40};
+static const unsigned int AUTOTUNE_PREWARM[] = {1, 2, 3, 5, 8, 12};
+static const unsigned int AUTOTUNE_HEARTBEAT_S[] = {1, 2, 5, 10};
+
+// Measurements of one autotune trial
+struct AutotuneTrial
+{
+	Tuning tuning;
+	uint64_t count;
+	uint64_t p50Us;
+	uint64_t p99Us;
+	double cpuPercent;
+};
+
+void
+printTitle()
+{
+	std::cout
+		<< " _________________________\n"
+		<< "|                         |\n"
+		<< "|         NDN-MIDI        |\n"
+		<< "|         Jam Node        |\n"
+		<< "|_________________________|\n";
+}
+
+// Heartbeats and connection monitoring for both halves of the node
+// In a group session the stream is live while any member is followed
+// A speed above 1 runs the timers faster (soak tests)
+void
+housekeeping(PlaybackModule& playbackModule, Controller *controller, bool group, unsigned int speed)
+{
+	for (int tick = 0; ; ++tick)
+	{
+		if (controller && group)
+		{
+			controller->setConnected(playbackModule.getConnectionCount() > 0);
+		}
+		else if (controller && tick % controller->getTuning()->heartbeatPeriodS == 0)
+		{
+			controller->heartbeatTick();
+		}
+		SLEEP(1000 / speed);
+		playbackModule.monitorTick();
+	}
+}
+
+// Drive connection churn and resource sampling for durationS seconds,
+// then exit with the verdict of the trend check
+void
+soak(ndn::Face& face, PlaybackModule& playbackModule, Controller& controller,
+	 double durationS, unsigned int speed)
+{
+	ResourceMonitor monitor;
+	monitor.addSeries("pending_interests", 20, [&face] {
+		// The Face belongs to the face thread, which counts for us
+		std::shared_ptr<std::promise<size_t> > count = std::make_shared<std::promise<size_t> >();
+		std::future<size_t> counted = count->get_future();
+		face.getIoService().post([&face, count] {
+			count->set_value(face.getNPendingInterests());
+		});
+		return (double)counted.get();
+	});
+	monitor.addSeries("controller_queue", 20, [&controller] {
+		return (double)controller.getQueueDepth();
+	});
+	monitor.addSeries("output_queue", 20, [&playbackModule] {
+		return (double)playbackModule.getQueueDepth();
+	});
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::chrono::milliseconds churnPeriod(1000 * SOAK_CHURN_PERIOD_S / speed);
+	std::chrono::steady_clock::time_point nextChurn = start + churnPeriod;
+	std::chrono::steady_clock::time_point nextSample = start;
+	while (true)
+	{
+		SLEEP(100);
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (now >= nextChurn)
+		{
+			// Connections belong to the face thread
+			face.getIoService().post([&playbackModule] {
+				playbackModule.clearAllConnections();
+			});
+			nextChurn += churnPeriod;
+		}
+		if (now >= nextSample)
+		{
+			monitor.sample();
+			monitor.printLatest(std::cout);
+			nextSample += std::chrono::seconds(SOAK_SAMPLE_PERIOD_S);
+		}
+		if (now - start >= std::chrono::duration<double>(durationS))
+		{
+			bool stable = monitor.checkTrends(std::cout);
+			std::cout << (stable ? "Soak passed" : "Soak FAILED: resource use grows") << std::endl;
+			exit(stable ? 0 : 1);
+		}
+	}
+}
+
+// Count the Face's socket writes against the MIDI events sent for
+// durationS seconds after connecting, print the ratios and exit
+void
+benchWrites(const BatchingTransport& transport, PlaybackModule& playbackModule,
+			Controller& controller, bool batched, double durationS)
+{
+	for (int i = 0; i < 100 && playbackModule.getConnectionCount() == 0; i++)
+	{
+		SLEEP(100);
+	}
+	SLEEP(1000 * AUTOTUNE_SETTLE_S);
+
+	unsigned long writes = transport.getWriteCount();
+	unsigned long packets = transport.getPacketCount();
+	unsigned long events = controller.getSentMessageCount();
+	SLEEP(1000 * durationS);
+	writes = transport.getWriteCount() - writes;
+	packets = transport.getPacketCount() - packets;
+	events = controller.getSentMessageCount() - events;
+
+	std::cout << "Bench (" << (batched ? "batched" : "immediate") << " writes, "
+			  << durationS << " s): " << writes << " socket writes, "
+			  << packets << " packets, " << events << " MIDI events" << std::endl;
+	if (events == 0 || writes == 0)
+	{
+		std::cerr << "Bench FAILED: no events were sent" << std::endl;
+		exit(1);
+	}
+	std::cout << "Bench: " << std::fixed << std::setprecision(2)
+			  << (double)writes / events << " writes per event, "
+			  << (double)packets / writes << " packets per write" << std::endl;
+	exit(0);
+}
+
+// CPU time used by the calling thread
+double
+threadCpuS()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Notify a thread waiting like output_sender ratePerS times a second
+// with each wait strategy for durationS seconds, and print how long it
+// took to wake up and how much CPU it used
+void
+benchWait(double durationS, long ratePerS)
+{
+	const WaitMode modes[] = {WAIT_SPIN, WAIT_SPIN_PARK, WAIT_BLOCK};
+	for (WaitMode mode : modes)
+	{
+		WaitStrategy wakeup(mode);
+		std::atomic<uint64_t> produced(0);
+		std::atomic<bool> running(true);
+		double cpuS = 0;
+		std::thread consumer([&] {
+			double startS = threadCpuS();
+			uint64_t consumed = 0;
+			while (running)
+			{
+				uint32_t ticket = wakeup.prepare();
+				if (produced.load() != consumed)
+				{
+					consumed = produced.load();
+					continue;
+				}
+				wakeup.wait(ticket);
+			}
+			cpuS = threadCpuS() - startS;
+		});
+
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now()
+			+ std::chrono::microseconds((long)(durationS * 1000000));
+		while (std::chrono::steady_clock::now() < end)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(1000000 / ratePerS));
+			++produced;
+			wakeup.notify();
+		}
+		running = false;
+		wakeup.notify();
+		consumer.join();
+
+		LatencyHistogram& latency = wakeup.getWakeLatency();
+		std::cout << "Bench " << std::left << std::setw(10) << waitModeName(mode) << std::right
+				  << std::fixed << std::setprecision(1)
+				  << latency.getCount() << " wakes, p50 " << latency.getPercentile(50) / 1000.0
+				  << " us, p99 " << latency.getPercentile(99) / 1000.0
+				  << " us, max " << latency.getMax() / 1000.0
+				  << " us, cpu " << 100 * cpuS / durationS << "%" << std::endl;
+	}
+}
+
+// Reconnect to ourselves with tuning and measure latency and CPU use
+// for trialS seconds
+AutotuneTrial
+autotuneTrial(PlaybackModule& playbackModule, Controller& controller,
+			  const std::string& nodeName, const Tuning& tuning, double trialS)
+{
+	controller.setTuning(tuning);
+	playbackModule.setTuning(tuning);
+
+	// The controller reconnects on its next heartbeat, with the new window
+	playbackModule.requestClearAllConnections();
+	for (int i = 0; i < 10 && playbackModule.getConnectionCount() > 0; i++)
+	{
+		SLEEP(100);
+	}
+	for (unsigned int i = 0; i < 10 * (tuning.heartbeatPeriodS + 2) && playbackModule.getConnectionCount() == 0; i++)
+	{
+		SLEEP(100);
+	}
+	SLEEP(1000 * AUTOTUNE_SETTLE_S);
+
+	AutotuneTrial trial = {tuning, 0, 0, 0, 0};
+	LatencyHistogram *latency = playbackModule.getLatency(nodeName);
+	if (latency == NULL)
+	{
+		std::cout << "Autotune: no connection, trial skipped" << std::endl;
+		return trial;
+	}
+	// The face thread records, so measure against a snapshot
+	LatencySnapshot start = latency->snapshot();
+	ResourceMonitor monitor;
+	SLEEP(1000 * trialS);
+	monitor.sample();
+
+	trial.count = latency->getCountSince(start);
+	trial.p50Us = latency->getPercentileSince(start, 50);
+	trial.p99Us = latency->getPercentileSince(start, 99);
+	trial.cpuPercent = monitor.getLatest("cpu_percent");
+	std::cout << "Autotune: packet-messages " << tuning.packetMessages
+			  << " prewarm " << tuning.prewarm
+			  << " heartbeat-period-s " << tuning.heartbeatPeriodS
+			  << ": " << trial.count << " events, p50 " << trial.p50Us << " us, p99 " << trial.p99Us
+			  << " us, cpu " << std::fixed << std::setprecision(1) << trial.cpuPercent << "%" << std::endl;
+	return trial;
+}
+
+// Index of the fastest trial, preferring lower CPU use among trials
+// within AUTOTUNE_LATENCY_TOLERANCE of it, or trials.size() if none
+// measured anything
+size_t
+fastestTrial(const std::vector<AutotuneTrial>& trials)
+{
+	uint64_t bestP99 = UINT64_MAX;
+	for (const AutotuneTrial& trial : trials)
+	{
+		if (trial.count > 0)
+		{
+			bestP99 = std::min(bestP99, trial.p99Us);
+		}
+	}
+	size_t best = trials.size();
+	for (size_t i = 0; i < trials.size(); i++)
+	{
+		if (trials[i].count > 0 && trials[i].p99Us <= bestP99 * (1 + AUTOTUNE_LATENCY_TOLERANCE)
+			&& (best == trials.size() || trials[i].cpuPercent < trials[best].cpuPercent))
+		{
+			best = i;
+		}
+	}
+	return best;
+}
+
+// Index of the shortest heartbeat period within AUTOTUNE_CPU_TOLERANCE
+// of the cheapest, as it notices failures soonest
+size_t
+cheapestTrial(const std::vector<AutotuneTrial>& trials)
+{
+	double minCpu = 100 * std::thread::hardware_concurrency();
+	for (const AutotuneTrial& trial : trials)
+	{
+		if (trial.count > 0)
+		{
+			minCpu = std::min(minCpu, trial.cpuPercent);
+		}
+	}
+	size_t best = trials.size();
+	for (size_t i = 0; i < trials.size(); i++)
+	{
+		if (trials[i].count > 0 && trials[i].cpuPercent <= minCpu + AUTOTUNE_CPU_TOLERANCE
+			&& (best == trials.size() || trials[i].tuning.heartbeatPeriodS < trials[best].tuning.heartbeatPeriodS))
+		{
+			best = i;
+		}
+	}
+	return best;
+}
+
+// Sweep the packet size, then the Interest window, then the heartbeat
+// period, each with the best values found so far, write the result to
+// outName and exit
+// The Interest lifetime and the input queue size matter when packets
+// are lost or input stalls, which a loopback run cannot show; they are
+// carried over from start
+void
+autotune(PlaybackModule& playbackModule, Controller& controller,
+		 const std::string& nodeName, const Tuning& start, double trialS,
+		 const std::string& workload, const std::string& outName)
+{
+	Tuning best = start;
+	std::vector<AutotuneTrial> trials;
+	size_t chosen;
+
+	for (unsigned int value : AUTOTUNE_PACKET_MESSAGES)
+	{
+		Tuning tuning = best;
+		tuning.packetMessages = value;
+		trials.push_back(autotuneTrial(playbackModule, controller, nodeName, tuning, trialS));
+	}
+	chosen = fastestTrial(trials);
+	if (chosen == trials.size())
+	{
+		std::cerr << "Autotune FAILED: no trial received any events" << std::endl;
+		exit(1);
+	}
+	best.packetMessages = trials[chosen].tuning.packetMessages;
+
+	trials.clear();
+	for (unsigned int value : AUTOTUNE_PREWARM)
+	{
+		Tuning tuning = best;
+		tuning.prewarm = value;
+		trials.push_back(autotuneTrial(playbackModule, controller, nodeName, tuning, trialS));
+	}
+	chosen = fastestTrial(trials);
+	if (chosen < trials.size())
+	{
+		best.prewarm = trials[chosen].tuning.prewarm;
+	}
+	AutotuneTrial result = trials[chosen < trials.size() ? chosen : 0];
+
+	// A connection must outlive the gap between heartbeats
+	trials.clear();
+	for (unsigned int value : AUTOTUNE_HEARTBEAT_S)
+	{
+		Tuning tuning = best;
+		tuning.heartbeatPeriodS = value;
+		tuning.maxInactiveS = std::max(value, start.maxInactiveS);
+		trials.push_back(autotuneTrial(playbackModule, controller, nodeName, tuning, trialS));
+	}
+	chosen = cheapestTrial(trials);
+	if (chosen < trials.size())
+	{
+		best.heartbeatPeriodS = trials[chosen].tuning.heartbeatPeriodS;
+		best.maxInactiveS = trials[chosen].tuning.maxInactiveS;
+	}
+
+	std::ofstream out(outName.c_str());
+	out << "# Written by midi-ndn-node --autotune, " << workload << "\n"
+		<< "# p50 " << result.p50Us << " us, p99 " << result.p99Us << " us, cpu "
+		<< std::fixed << std::setprecision(1) << result.cpuPercent << "%\n";
+	best.write(out);
+	out.close();
+	if (!out)
+	{
+		std::cerr << "Autotune FAILED: could not write " << outName << std::endl;
+		exit(1);
+	}
+	std::cout << "Autotune: recommended settings written to " << outName << std::endl;
+	best.write(std::cout);
+	exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+	Options options(argc, argv);
+
+	// Rates and speeds divide time intervals
+	const char *positive[] = {"soak-speed", "soak-rate", "autotune-rate", "bench-rate"};
+	for (const char *key : positive)
+	{
+		if (options.has(key) && options.number(key, 1) < 1)
+		{
+			std::cerr << "usage: --" << key << "=<n>, with n at least 1" << std::endl;
+			return 1;
+		}
+	}
+
+	if (options.has("bench-wait"))
+	{
+		benchWait(options.number("bench-wait", BENCH_WAIT_S), options.number("bench-rate", BENCH_WAIT_RATE));
+		return 0;
+	}
+
+	if (options.size() < 1)
+	{
+		std::cerr << "usage: midi-ndn-node <node-name> [project-name] [--remote=<playback-module-name>[,<standby>...] | --group]" << std::endl;
+		return 1;
+	}
+
+	std::string nodeName = options.get(0);
+	std::string projName = options.get(1, "tmp-proj");
+	std::string remoteName = options.value("remote");
+	bool group = options.has("group");
+
+	// Soak tests play to themselves unless given a remote, autotuning
+	// and write benchmarks always play to themselves
+	bool soakTest = options.has("soak");
+	bool autotuneMode = options.has("autotune");
+	bool benchMode = options.has("bench-writes");
+	bool selfTest = soakTest || autotuneMode || benchMode;
+	unsigned int soakSpeed = soakTest ? options.number("soak-speed", 10) : 1;
+	if (autotuneMode || benchMode || (soakTest && remoteName.empty()))
+	{
+		remoteName = nodeName;
+	}
+
+	Tuning tuning;
+	if (options.has("config") && !tuning.loadFile(options.value("config")))
+	{
+		return 1;
+	}
+	// Latency budget of batching, e.g. --deadline-ms=2.5
+	if (options.has("deadline-ms"))
+	{
+		tuning.batchDeadlineUs = atof(options.value("deadline-ms").c_str()) * 1000;
+	}
+
+	// Input to record for later autotune runs
+	std::unique_ptr<std::ofstream> record;
+	if (options.has("record"))
+	{
+		record.reset(new std::ofstream(options.value("record").c_str()));
+		if (!*record)
+		{
+			std::cerr << "Could not open recording: " << options.value("record") << std::endl;
+			return 1;
+		}
+	}
+
+	// How the capture and send threads wait, spin-park unless given
+	WaitMode captureWait, sendWait;
+	std::string waitName = options.value("wait", "spin-park");
+	if (!parseWaitMode(options.value("capture-wait", waitName), captureWait)
+		|| !parseWaitMode(options.value("send-wait", waitName), sendWait))
+	{
+		std::cerr << "Wait strategies are spin, spin-park and block" << std::endl;
+		return 1;
+	}
+
+	std::vector<RecordedMessage> workload;
+	if (options.has("workload") && !loadRecording(options.value("workload"), workload))
+	{
+		return 1;
+	}
+	// Sequenced content to stream instead of the MIDI input
+	std::vector<RecordedMessage> sequence;
+	if (options.has("play") && !loadRecording(options.value("play"), sequence))
+	{
+		return 1;
+	}
+	double leadS = options.value("lookahead").empty() ? LOOKAHEAD_S : atof(options.value("lookahead").c_str());
+	std::vector<unsigned char> message;
+
+	printTitle();
+
+	try
+	{
+		// One Face for both directions; the write benchmark
+		// counts writes with or without batching
+		std::shared_ptr<BatchingTransport> transport;
+		if (options.has("batch-writes") || benchMode)
+		{
+			transport = std::make_shared<BatchingTransport>(options.value("batch-writes"),
+															options.has("batch-writes"));
+		}
+		ndn::Face face(transport);
+		ndn::KeyChain keyChain;
+
+		PlaybackModule playbackModule(face, keyChain, nodeName, projName, false);
+		playbackModule.setTuning(tuning);
+
+		std::vector<std::unique_ptr<ndn::Face> > paths;
+		if (options.has("paths"))
+		{
+			addPaths(playbackModule, face, options.value("paths"), paths);
+		}
+
+		// Only publish local input if there is someone to send it to
+		// KeyChain is not thread-safe, so the send thread has its own
+		ndn::KeyChain controllerKeyChain;
+		std::unique_ptr<Controller> controller;
+		if (!remoteName.empty() || group)
+		{
+			controller.reset(new Controller(face, controllerKeyChain, remoteName, nodeName, projName, false));
+			controller->setTuning(tuning);
+			controller->getSendWait().setMode(sendWait);
+		}
+
+		// Group session: announce our stream and follow everyone else's
+		std::unique_ptr<StateVectorSync> sync;
+		if (group)
+		{
+			sync.reset(new StateVectorSync(face, nodeName, projName,
+										   [&] (const std::string& member, uint64_t seqNo) {
+											   playbackModule.followStream(member, seqNo);
+										   }));
+			StateVectorSync *syncPtr = sync.get();
+			controller->setPublishCallback([syncPtr] (uint64_t seqNo) {
+				syncPtr->publish(seqNo);
+			});
+		}
+
+		std::thread housekeepingThread;
+
+		// Single registration: heartbeats and failover control are for the
+		// playback module, sequence numbers and shutdown are for the controller
+		face.setInterestFilter(playbackModule.getPrefix(),
+							   [&] (const ndn::InterestFilter&, const ndn::Interest& interest) {
+								   if (!PlaybackModule::controlKind(interest.getName()).empty())
+								   {
+									   playbackModule.onInterest(interest);
+								   }
+								   else if (controller)
+								   {
+									   controller->onInterest(interest);
+								   }
+							   },
+							   [&] (const ndn::Name& prefix) {
+								   std::cerr << "Prefix registered" << std::endl;
+								   housekeepingThread = std::thread(housekeeping, std::ref(playbackModule), controller.get(), group, soakSpeed);
+							   },
+							   [] (const ndn::Name& prefix, const std::string& reason) {
+								   std::cerr << "Failed to register prefix: " << reason << std::endl;
+							   });
+
+		// Data Interests under the controller's short names
+		if (controller)
+		{
+			Controller *controllerPtr = controller.get();
+			face.setInterestFilter(controller->getStreamPrefix(),
+								   [controllerPtr] (const ndn::InterestFilter&, const ndn::Interest& interest) {
+									   controllerPtr->onInterest(interest);
+								   },
+								   [] (const ndn::Name& prefix) {},
+								   [] (const ndn::Name& prefix, const std::string& reason) {
+									   std::cerr << "Failed to register prefix: " << reason << std::endl;
+								   });
+		}
+
+		if (options.has("state") && !playbackModule.enableCheckpoint(options.value("state")))
+		{
+			return 1;
+		}
+
+		if (options.has("acl"))
+		{
+			if (!playbackModule.getAccessControl().loadFile(options.value("acl")))
+			{
+				return 1;
+			}
+		}
+		else if (!selfTest)
+		{
+			playbackModule.specifyConnections();
+		}
+
+		if (options.has("transforms") && !playbackModule.getTransforms().loadFile(options.value("transforms")))
+		{
+			return 1;
+		}
+
+		// MIDI output for remote streams
+		playbackModule.midiout = new MidiOutput();
+		std::string portName;
+		chooseMidiPort( playbackModule.midiout, options.value("out-port", selfTest ? "virtual" : ""), &portName );
+		PortLatencyTable latencies;
+		if (latencies.load(options.value("latency-file", PORT_LATENCY_FILE)))
+		{
+			playbackModule.enableLatencyCompensation(latencies, portName);
+		}
+		if (options.has("din-rate"))
+		{
+			long baudRate = options.number("din-rate", DIN_BAUD_RATE);
+			if (baudRate <= 0)
+			{
+				std::cerr << "usage: --din-rate[=<baud>], with a baud rate above 0" << std::endl;
+				return 1;
+			}
+			playbackModule.enableOutputShaping(baudRate, options.has("din-running-status"));
+		}
+
+		if (options.has("metrics"))
+		{
+			playbackModule.enableMetricsFile(options.value("metrics"));
+		}
+
+		std::thread midiThread;
+		std::thread outputThread;
+		std::thread soakThread;
+		if (selfTest)
+		{
+			long rate = options.number(soakTest ? "soak-rate" : benchMode ? "bench-rate" : "autotune-rate", 50);
+			std::string workloadName = "synthetic input at " + std::to_string(rate) + " notes/s";
+			if (!workload.empty() && options.has("lookahead"))
+			{
+				midiThread = std::thread(lookaheadInput, std::ref(*controller), std::cref(workload), leadS);
+				workloadName = "recording " + options.value("workload") + " played ahead";
+			}
+			else if (!workload.empty())
+			{
+				midiThread = std::thread(recordedInput, std::ref(*controller), std::cref(workload));
+				workloadName = "recording " + options.value("workload");
+			}
+			else
+			{
+				midiThread = std::thread(syntheticInput, std::ref(*controller), rate);
+			}
+			outputThread = std::thread(output_sender, std::ref(*controller));
+			if (benchMode)
+			{
+				soakThread = std::thread(benchWrites, std::cref(*transport), std::ref(playbackModule),
+										 std::ref(*controller), options.has("batch-writes"),
+										 options.number("bench-writes", BENCH_WRITES_S));
+			}
+			else if (soakTest)
+			{
+				soakThread = std::thread(soak, std::ref(face), std::ref(playbackModule), std::ref(*controller),
+										 options.number("soak", 3600), soakSpeed);
+			}
+			else
+			{
+				soakThread = std::thread(autotune, std::ref(playbackModule), std::ref(*controller),
+										 nodeName, tuning, options.number("autotune", AUTOTUNE_TRIAL_S),
+										 workloadName, options.value("autotune-out", "ndnmidi-tuning.conf"));
+			}
+		}
+		else if (controller && !sequence.empty())
+		{
+			// Sequenced content for the remote, ahead of time with --lookahead
+			if (options.has("lookahead"))
+			{
+				midiThread = std::thread(lookaheadInput, std::ref(*controller), std::cref(sequence), leadS);
+			}
+			else
+			{
+				midiThread = std::thread(recordedInput, std::ref(*controller), std::cref(sequence));
+			}
+			outputThread = std::thread(output_sender, std::ref(*controller));
+		}
+		else if (controller)
+		{
+			// MIDI input for the local player
+			controller->midiin = newMidiInput(tuning.inputQueueSize);
+			if ( chooseMidiPort( controller->midiin ) == false )
+			{
+				return 1;
+			}
+			controller->midiin->ignoreTypes( true, true, true );
+
+			midiThread = std::thread(midiLoopNoBlock, controller->midiin, message, std::ref(*controller), record.get(), captureWait);
+			outputThread = std::thread(output_sender, std::ref(*controller));
+		}
+
+		std::thread menuThread;
+		if (!selfTest)
+		{
+			menuThread = std::thread(menuListener, std::ref(playbackModule));
+		}
+
+		// Start processing loop (it will block forever)
+		face.processEvents();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "ERROR: " << e.what() << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,202 @@
+/********************************
+
+LatencyHistogram.h
+
+HDR-style latency histogram for PlaybackModuleMIDI connections
+
+Values in microseconds are counted in log-linear buckets: exact below
+64 us, then 32 sub-buckets per power of two, so every recorded value
+is known to within about 3% at any magnitude with a fixed 3 KB table
+and O(1) recording. Percentiles report the upper bound of the bucket.
+
+Recording never blocks: the counters are relaxed atomics, and readers
+on other threads (menu, metrics) may see a snapshot torn by samples
+recorded while they walk the buckets. Only the recording thread may
+reset(); other threads measure an interval by taking a snapshot() at
+its start and reading the counts and percentiles since it.
+
+********************************/
+
+#ifndef NDNMIDI_LATENCY_HISTOGRAM_H
+#define NDNMIDI_LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+
+#include <atomic>
+
+// Sub-buckets per power of two, as a power of two, and the largest
+// recordable value (about 67 s)
+#define LATENCY_SUB_BUCKET_BITS 5
+#define LATENCY_MAX_US ((1ull << 26) - 1)
+
+#define LATENCY_SUB_BUCKETS (1u << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_BUCKET_COUNT (2 * LATENCY_SUB_BUCKETS + (26 - LATENCY_SUB_BUCKET_BITS - 1) * LATENCY_SUB_BUCKETS)
+
+// Bucket counts at one moment
+struct LatencySnapshot
+{
+	uint64_t counts[LATENCY_BUCKET_COUNT];
+	uint64_t total;
+};
+
+class LatencyHistogram
+{
+public:
+	LatencyHistogram()
+	{
+		reset();
+	}
+
+	// Only from the thread that records
+	void
+	reset()
+	{
+		for (unsigned int i = 0; i < LATENCY_BUCKET_COUNT; ++i)
+		{
+			m_counts[i].store(0, std::memory_order_relaxed);
+		}
+		m_total.store(0, std::memory_order_relaxed);
+		m_max.store(0, std::memory_order_relaxed);
+	}
+
+	// Count one latency sample, larger values are clamped
+	void
+	record(uint64_t valueUs)
+	{
+		if (valueUs > LATENCY_MAX_US)
+		{
+			valueUs = LATENCY_MAX_US;
+		}
+		m_counts[bucketIndex(valueUs)].fetch_add(1, std::memory_order_relaxed);
+		m_total.fetch_add(1, std::memory_order_relaxed);
+		uint64_t max = m_max.load(std::memory_order_relaxed);
+		while (valueUs > max && !m_max.compare_exchange_weak(max, valueUs, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	uint64_t
+	getCount() const
+	{
+		return m_total.load(std::memory_order_relaxed);
+	}
+
+	uint64_t
+	getMax() const
+	{
+		return m_max.load(std::memory_order_relaxed);
+	}
+
+	// Smallest bucket bound that at least percentile % of samples are at
+	// or below, 0 if there are no samples
+	uint64_t
+	getPercentile(double percentile) const
+	{
+		uint64_t total = getCount();
+		uint64_t max = getMax();
+		if (total == 0)
+		{
+			return 0;
+		}
+		uint64_t rank = (uint64_t)(percentile / 100.0 * total + 0.5);
+		if (rank < 1)
+		{
+			rank = 1;
+		}
+		uint64_t seen = 0;
+		for (unsigned int i = 0; i < LATENCY_BUCKET_COUNT; ++i)
+		{
+			seen += m_counts[i].load(std::memory_order_relaxed);
+			if (seen >= rank)
+			{
+				uint64_t bound = bucketUpperBound(i);
+				return bound < max ? bound : max;
+			}
+		}
+		return max;
+	}
+
+	LatencySnapshot
+	snapshot() const
+	{
+		LatencySnapshot copy;
+		for (unsigned int i = 0; i < LATENCY_BUCKET_COUNT; ++i)
+		{
+			copy.counts[i] = m_counts[i].load(std::memory_order_relaxed);
+		}
+		copy.total = getCount();
+		return copy;
+	}
+
+	// Samples recorded since base was taken
+	uint64_t
+	getCountSince(const LatencySnapshot& base) const
+	{
+		return getCount() - base.total;
+	}
+
+	// Like getPercentile(), for the samples recorded since base was taken
+	uint64_t
+	getPercentileSince(const LatencySnapshot& base, double percentile) const
+	{
+		uint64_t total = getCountSince(base);
+		if (total == 0)
+		{
+			return 0;
+		}
+		uint64_t rank = (uint64_t)(percentile / 100.0 * total + 0.5);
+		if (rank < 1)
+		{
+			rank = 1;
+		}
+		uint64_t seen = 0;
+		uint64_t bound = 0;
+		for (unsigned int i = 0; i < LATENCY_BUCKET_COUNT; ++i)
+		{
+			uint64_t added = m_counts[i].load(std::memory_order_relaxed) - base.counts[i];
+			if (added == 0)
+			{
+				continue;
+			}
+			seen += added;
+			bound = bucketUpperBound(i);
+			if (seen >= rank)
+			{
+				break;
+			}
+		}
+		return bound;
+	}
+
+private:
+	// Values below 2 * LATENCY_SUB_BUCKETS map to themselves, larger ones
+	// keep their top LATENCY_SUB_BUCKET_BITS + 1 bits
+	static unsigned int
+	bucketIndex(uint64_t value)
+	{
+		if (value < 2 * LATENCY_SUB_BUCKETS)
+		{
+			return (unsigned int)value;
+		}
+		unsigned int shift = 63 - __builtin_clzll(value) - LATENCY_SUB_BUCKET_BITS;
+		return shift * LATENCY_SUB_BUCKETS + (unsigned int)(value >> shift);
+	}
+
+	static uint64_t
+	bucketUpperBound(unsigned int index)
+	{
+		if (index < 2 * LATENCY_SUB_BUCKETS)
+		{
+			return index;
+		}
+		unsigned int shift = index / LATENCY_SUB_BUCKETS - 1;
+		uint64_t sub = index % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS;
+		return ((sub + 1) << shift) - 1;
+	}
+
+	std::atomic<uint32_t> m_counts[LATENCY_BUCKET_COUNT];
+	std::atomic<uint64_t> m_total;
+	std::atomic<uint64_t> m_max;
+};
+
+#endif
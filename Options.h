@@ -0,0 +1,92 @@
+/********************************
+
+Options.h
+
+Command-line parsing shared by the NDN-MIDI applications
+
+Arguments of the form --key=value (or --flag) are collected as options,
+everything else is kept as a positional argument in its original order
+
+********************************/
+
+#ifndef NDNMIDI_OPTIONS_H
+#define NDNMIDI_OPTIONS_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+
+class Options
+{
+public:
+	Options(int argc, char *argv[])
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string arg = argv[i];
+			if (arg.size() > 2 && arg.compare(0, 2, "--") == 0)
+			{
+				size_t eq = arg.find('=');
+				if (eq == std::string::npos)
+				{
+					m_options[arg.substr(2)] = "";
+				}
+				else
+				{
+					m_options[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+				}
+			}
+			else
+			{
+				m_positional.push_back(arg);
+			}
+		}
+	}
+
+	// Number of positional arguments
+	size_t
+	size() const
+	{
+		return m_positional.size();
+	}
+
+	// Positional argument i, or def if not given
+	std::string
+	get(size_t i, const std::string& def = "") const
+	{
+		return i < m_positional.size() ? m_positional[i] : def;
+	}
+
+	bool
+	has(const std::string& key) const
+	{
+		return m_options.count(key) > 0;
+	}
+
+	// Value of --key=value, or def if not given
+	std::string
+	value(const std::string& key, const std::string& def = "") const
+	{
+		std::map<std::string, std::string>::const_iterator it = m_options.find(key);
+		return it == m_options.end() ? def : it->second;
+	}
+
+	long
+	number(const std::string& key, long def) const
+	{
+		std::map<std::string, std::string>::const_iterator it = m_options.find(key);
+		if (it == m_options.end() || it->second.empty())
+		{
+			return def;
+		}
+		return strtol(it->second.c_str(), NULL, 10);
+	}
+
+private:
+	std::vector<std::string> m_positional;
+	std::map<std::string, std::string> m_options;
+};
+
+#endif
@@ -0,0 +1,243 @@
+/********************************
+
+OutputShaper.h
+
+Bandwidth-aware output queue for MIDI ports with a slow physical link
+
+Models the link as a serial line (10 bits per byte, 31.25 kbaud for
+5-pin DIN) and only hands a message to the port when the previous one
+has left the wire, so the backlog stays here where it can be managed
+instead of piling up in the interface:
+
+  - notes and other order-sensitive messages are sent first, in order
+  - continuous data (controllers, pitch bend, channel pressure) waits
+    behind them, and a newer value replaces a pending older one for the
+    same channel/controller instead of queueing behind it
+  - every message costs its full size, status byte included; running
+    status is only counted for ports known to use it, since RtMidi is
+    handed whole messages and may or may not drop repeated status bytes
+
+Switch controllers (sustain etc.), bank select, RPN/NRPN data entry and
+channel mode messages keep their order and are never coalesced.
+
+********************************/
+
+#ifndef NDNMIDI_OUTPUT_SHAPER_H
+#define NDNMIDI_OUTPUT_SHAPER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Baud rate of a 5-pin DIN MIDI link
+#define DIN_BAUD_RATE 31250
+
+// Bits on the wire per MIDI byte (start + 8 data + stop)
+#define MIDI_BITS_PER_BYTE 10
+
+class OutputShaper
+{
+public:
+	typedef std::function<void(std::vector<unsigned char>*)> SendCallback;
+
+	OutputShaper(const SendCallback& send, unsigned int baudRate = DIN_BAUD_RATE, bool runningStatus = false)
+		: m_send(send)
+		, m_byteTime(std::chrono::microseconds(1000000 * MIDI_BITS_PER_BYTE / baudRate))
+		, m_useRunningStatus(runningStatus)
+		, m_runningStatus(0)
+		, m_nextFree(std::chrono::steady_clock::now())
+		, m_stop(false)
+		, m_coalesced(0)
+	{
+		m_thread = std::thread(&OutputShaper::run, this);
+	}
+
+	~OutputShaper()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wakeup.notify_one();
+		m_thread.join();
+	}
+
+	// Queue a MIDI 1.0 message for output
+	void
+	enqueue(const unsigned char *bytes, size_t size)
+	{
+		if (size == 0)
+		{
+			return;
+		}
+		std::vector<unsigned char> msg(bytes, bytes + size);
+		int key = continuousKey(msg);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (key < 0)
+			{
+				m_ordered.push_back(msg);
+			}
+			else if (m_latest.count(key) > 0)
+			{
+				// Superseded value still waiting, replace it
+				m_latest[key] = msg;
+				++m_coalesced;
+				return;
+			}
+			else
+			{
+				m_latest[key] = msg;
+				m_continuous.push_back(key);
+			}
+		}
+		m_wakeup.notify_one();
+	}
+
+	// Messages waiting for the link
+	size_t
+	getQueueDepth()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_ordered.size() + m_continuous.size();
+	}
+
+	// Messages dropped because a newer value replaced them
+	unsigned long
+	getCoalescedCount()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_coalesced;
+	}
+
+private:
+	// Coalescing key of a continuous data message, or -1
+	static int
+	continuousKey(const std::vector<unsigned char>& msg)
+	{
+		unsigned char type = msg[0] & 0xF0;
+		int channel = msg[0] & 0x0F;
+		switch (type)
+		{
+			case 0xB0:
+			{
+				if (msg.size() < 3)
+				{
+					return -1;
+				}
+				unsigned char controller = msg[1];
+				// Bank select, data entry, switches, (N)RPN and mode messages keep their order
+				if (controller == 0 || controller == 32 || controller == 6 || controller == 38
+					|| (controller >= 64 && controller <= 69)
+					|| (controller >= 96 && controller <= 101)
+					|| controller >= 120)
+				{
+					return -1;
+				}
+				return (channel << 8) | controller;
+			}
+			case 0xD0:
+				return (channel << 8) | 0x80;
+			case 0xE0:
+				return (channel << 8) | 0x81;
+			default:
+				return -1;
+		}
+	}
+
+	// Bytes put on the wire, using running status where the port does
+	size_t
+	wireBytes(const std::vector<unsigned char>& msg)
+	{
+		unsigned char status = msg[0];
+		if (!m_useRunningStatus)
+		{
+			return msg.size();
+		}
+		if (status >= 0xF8)
+		{
+			// Real time messages do not affect running status
+			return msg.size();
+		}
+		if (status >= 0xF0)
+		{
+			m_runningStatus = 0;
+			return msg.size();
+		}
+		if (status == m_runningStatus)
+		{
+			return msg.size() - 1;
+		}
+		m_runningStatus = status;
+		return msg.size();
+	}
+
+	void
+	run()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_stop)
+		{
+			if (m_ordered.empty() && m_continuous.empty())
+			{
+				m_wakeup.wait(lock);
+				continue;
+			}
+
+			// Wait until the previous message has left the wire
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			if (now < m_nextFree)
+			{
+				m_wakeup.wait_until(lock, m_nextFree);
+				continue;
+			}
+
+			std::vector<unsigned char> msg;
+			if (!m_ordered.empty())
+			{
+				msg.swap(m_ordered.front());
+				m_ordered.pop_front();
+			}
+			else
+			{
+				int key = m_continuous.front();
+				m_continuous.pop_front();
+				msg.swap(m_latest[key]);
+				m_latest.erase(key);
+			}
+
+			m_nextFree = now + m_byteTime * wireBytes(msg);
+
+			lock.unlock();
+			m_send(&msg);
+			lock.lock();
+		}
+	}
+
+	SendCallback m_send;
+	std::chrono::microseconds m_byteTime;
+	bool m_useRunningStatus;
+	unsigned char m_runningStatus;
+	std::chrono::steady_clock::time_point m_nextFree;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wakeup;
+	bool m_stop;
+
+	// Notes and other messages that must keep their order
+	std::deque<std::vector<unsigned char> > m_ordered;
+
+	// Coalescing keys of pending continuous data, oldest first
+	std::deque<int> m_continuous;
+	std::map<int, std::vector<unsigned char> > m_latest;
+	unsigned long m_coalesced;
+
+	std::thread m_thread;
+};
+
+#endif
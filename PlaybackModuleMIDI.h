@@ -0,0 +1,1851 @@
+/********************************
+
+PlaybackModuleMIDI.h
+
+PlaybackModule class shared by PlaybackModuleMIDI and the midi-ndn-node jam node
+
+Receives and plays back MIDI messages received from ControllerMIDI
+on user designated MIDI port.
+
+Receives interest and sends data for connection setup and heartbeat messages
+Sends interest for MIDI messages
+
+Measures one-way latency per connection from the capture timestamps
+carried with every event, in per-channel latency histograms
+
+Data Interests can be expressed over several Faces (paths) at once.
+The first copy of each packet is played and later copies are dropped
+using a sliding bitmap of received sequence numbers, so latency
+follows whichever path is fastest at the moment.
+
+Controllers that propose a stream id in the handshake are fetched under
+short names, /m/<id>/<seqNo> (see StreamNames.h).
+
+A controller may keep this module as a hot standby (see ControllerMIDI.h):
+standby heartbeats are answered without connecting, and a takeover
+Interest connects starting at the packet the failed module had not played.
+
+Events sent ahead of time carry a Play-At word (see UniversalMidiPacket.h)
+and wait in the playout scheduler until their time, plus any latency
+compensation, so network jitter never reaches them.
+
+********************************/
+
+#ifndef NDNMIDI_PLAYBACK_MODULE_MIDI_H
+#define NDNMIDI_PLAYBACK_MODULE_MIDI_H
+
+#include <ndn-cxx/face.hpp>
+#include <ndn-cxx/interest.hpp>
+#include <ndn-cxx/data.hpp>
+#include <ndn-cxx/security/key-chain.hpp>
+#include <ndn-cxx/security/signing-helpers.hpp>
+#include <ndn-cxx/transport/tcp-transport.hpp>
+
+#include <iostream>
+#include <string>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "RtMidi.h"
+#include "UniversalMidiPacket.h"
+#include "BatchDecode.h"
+#include "StateCheckpoint.h"
+#include "OutputShaper.h"
+#include "AccessControl.h"
+#include "LatencyHistogram.h"
+#include "PlayoutScheduler.h"
+#include "PortLatency.h"
+#include "EventTransform.h"
+#include "Tuning.h"
+#include "StreamNames.h"
+#include "Tracepoints.h"
+
+// Define platform-dependent sleep routines.
+#if defined(__WINDOWS_MM__)
+  #include <windows.h>
+  #define SLEEP( milliseconds ) Sleep( (DWORD) milliseconds ) 
+#else // Unix variants
+  #include <unistd.h>
+  #define SLEEP( milliseconds ) usleep( (unsigned long) (milliseconds * 1000.0) )
+#endif
+
+// Define maximum number of MIDI channels
+#define MAX_CHANNELS 16
+
+// Define maximum age in seconds of a state file that is resumed on startup
+#define MAX_RESUME_AGE_S 15
+
+// Define maximum size in bytes of the MIDI content of a data packet
+#define MAX_PACKET_SIZE 1024
+
+// Define default file of measured output port latencies
+#define PORT_LATENCY_FILE "ndnmidi-port-latency.txt"
+
+// Define interval in seconds between writes of the metrics file
+#define METRICS_PERIOD_S 10
+
+// Later packets that must arrive before a missing one is asked for again
+#define LOSS_REORDER_PACKETS 3
+
+// Define age in seconds after which a cached heartbeat reply is re-signed
+#define HEARTBEAT_REPLY_MAX_AGE_S 300
+
+// Most Faces data Interests are expressed over, the main one included
+#define MAX_PATHS 8
+
+// Statically dispatched RtMidi front end when one backend is compiled in
+#if defined(RTMIDI_SINGLE_BACKEND)
+typedef RtMidiOutT<RtMidiStaticBackend> MidiOutput;
+#else
+typedef RtMidiOut MidiOutput;
+#endif
+
+static_assert(MAX_CHANNELS == CHECKPOINT_SLOTS, "State file needs one slot per channel");
+
+// MIDI message information for a single connection
+// minSeqNo is the oldest packet not received yet, maxSeqNo the next to
+// request; bit i of received is set once minSeqNo + i has arrived
+// streamId is the short name id of the stream, 0 for full names
+// With acks, data Interests carry minSeqNo so the controller can forget
+// what has arrived; retxSeqNo is the last missing packet asked for again
+struct MIDIControlBlock
+{
+	int minSeqNo;
+	int maxSeqNo;
+	int inactiveTime;
+	int channel;
+	uint64_t received;
+	uint64_t streamId;
+	bool acks;
+	int retxSeqNo;
+
+	// Record the arrival of seqNo
+	// Returns false for a duplicate or out-of-date packet
+	bool
+	markReceived(int seqNo)
+	{
+		if (seqNo < minSeqNo)
+		{
+			return false;
+		}
+		int offset = seqNo - minSeqNo;
+		if (offset >= 64)
+		{
+			// Give up on the oldest missing packets
+			int slide = offset - 63;
+			received = slide >= 64 ? 0 : received >> slide;
+			minSeqNo += slide;
+			offset -= slide;
+		}
+		if ((received >> offset) & 1)
+		{
+			return false;
+		}
+		received |= 1ull << offset;
+
+		// Advance past everything received in order
+		while (received & 1)
+		{
+			received >>= 1;
+			++minSeqNo;
+		}
+		return true;
+	}
+};
+
+// Signed heartbeat reply of a connection, reused for every heartbeat
+// The freshness period starts when the Data is put, so the same packet
+// can be answered again and again without re-signing
+struct HeartbeatReply
+{
+	std::shared_ptr<ndn::Data> data;
+	std::chrono::steady_clock::time_point signedAt;
+};
+
+// Connections as seen from threads other than the face thread
+// The face thread owns m_lookup and channelList and publishes a new
+// snapshot whenever a connection is made or closed, never per packet.
+// Readers take a reference to the current one and never wait for, or
+// hold up, onData
+struct ConnectionSnapshot
+{
+	std::string channelList[MAX_CHANNELS];
+	int count = 0;
+};
+
+
+class PlaybackModule
+{
+public:
+	// A standalone PlaybackModule registers its own prefix and runs its
+	// own monitoring thread. Otherwise the owner (e.g. the jam node) must
+	// pass it interests through onInterest() and call monitorTick().
+	PlaybackModule(ndn::Face& face, ndn::KeyChain& keyChain, const std::string& hostname,
+				   const std::string& projname, bool standalone = true)
+		: m_face(face)
+		, m_keyChain(keyChain)
+		, m_baseName(ndn::Name("/topo-prefix/" + hostname + "/midi-ndn/" + projname))
+		, m_projName(projname)
+		, m_pathCount(1)
+	{
+		m_paths[0] = &face;
+		for (int i = 0; i < MAX_PATHS; i++)
+		{
+			m_pathWins[i] = 0;
+		}
+
+		// Pick SIMD or scalar packet decoding for this CPU
+		const char *decoderName;
+		m_batchDecode = selectBatchDecoder(&decoderName);
+		std::cerr << "Packet decoder: " << decoderName << std::endl;
+
+		if (standalone)
+		{
+			// Set interest filter for connection setup
+			m_face.setInterestFilter(m_baseName,
+									 std::bind(&PlaybackModule::onInterest, this, _2),
+									 std::bind([] {
+										std::cerr << "Prefix registered" << std::endl;
+
+									 }),
+									 [] (const ndn::Name& prefix, const std::string& reason) {
+										std::cerr << "Failed to register prefix: " << reason << std::endl;
+									 });
+
+			// Thread to check for and remove stale connections
+			cbMonitor = std::thread(&PlaybackModule::controlBlockMonitoring, this);
+		}
+
+		setupComplete = true;
+
+	}
+
+	// Stop the monitor thread, so main can return early
+	~PlaybackModule()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_monitorMutex);
+			m_monitorStop = true;
+		}
+		m_monitorWake.notify_all();
+		if (cbMonitor.joinable())
+		{
+			cbMonitor.join();
+		}
+	}
+
+	bool
+	getSetupComplete()
+	{
+		return setupComplete;
+	}
+
+	bool
+	getViewingMenu()
+	{
+		return viewingMenu;
+	}
+
+	void
+	setViewingMenu()
+	{
+		viewingMenu = true;
+	}
+
+	void
+	unsetViewingMenu()
+	{
+		viewingMenu = false;
+	}
+
+	const ndn::Name&
+	getPrefix()
+	{
+		return m_baseName;
+	}
+
+	int
+	getConnectionCount()
+	{
+		return getConnections()->count;
+	}
+
+	// Latest published connections, safe to read from any thread
+	std::shared_ptr<const ConnectionSnapshot>
+	getConnections()
+	{
+		return std::atomic_load(&m_connections);
+	}
+
+	AccessControl&
+	getAccessControl()
+	{
+		return m_acl;
+	}
+
+	EventTransforms&
+	getTransforms()
+	{
+		return m_transforms;
+	}
+
+	// Latency histogram of remoteName's connection, or NULL
+	LatencyHistogram*
+	getLatency(const std::string& remoteName)
+	{
+		std::shared_ptr<const ConnectionSnapshot> connections = getConnections();
+		for (int i = 0; i < MAX_CHANNELS; i++)
+		{
+			if (connections->channelList[i] == remoteName)
+			{
+				return &m_latency[i];
+			}
+		}
+		return NULL;
+	}
+
+	// Replace the Interest window, lifetime and inactivity limit; a new
+	// window applies to connections made afterwards
+	void
+	setTuning(const Tuning& tuning)
+	{
+		std::atomic_store(&m_tuning, std::shared_ptr<const Tuning>(std::make_shared<Tuning>(tuning)));
+	}
+
+	std::shared_ptr<const Tuning>
+	getTuning()
+	{
+		return std::atomic_load(&m_tuning);
+	}
+
+	bool
+	getVerboseMode()
+	{
+		return verboseMode;
+	}
+
+	void
+	setVerboseMode()
+	{
+		verboseMode = true;
+	}
+
+	void
+	unsetVerboseMode()
+	{
+		verboseMode = false;
+	}
+
+	void
+	toggleVerboseMode()
+	{
+		if (verboseMode)
+		{
+			verboseMode = false;
+		}
+		else 
+		{
+			verboseMode = true;
+		}
+	}
+
+	// Print connected devices menu 
+	void
+	printConnections()
+	{
+		std::shared_ptr<const ConnectionSnapshot> connections = getConnections();
+		const std::string *channelList = connections->channelList;
+		bool noConnections = true;
+		std::cout
+		<< " ____________________________________\n"
+		<< "|      ----- Connections -----       |\n"
+		<< "|                                    |\n";
+		for (int i = 0; i < MAX_CHANNELS; i++)
+		{
+			if (channelList[i] != "")
+			{
+				std::cout << "| Channel "
+					<< i
+					<< ": "
+					<< channelList[i];
+				int extraSpace = 24 - channelList[i].size();
+				for (int i = 0; i < extraSpace; i++) {
+					std::cout << " ";
+				}
+				std::cout << "|" << std::endl;
+				if (m_latency[i].getCount() > 0)
+				{
+					std::ostringstream latency;
+					latency << std::fixed << std::setprecision(1)
+							<< "   p50 " << m_latency[i].getPercentile(50) / 1000.0
+							<< " ms  p99 " << m_latency[i].getPercentile(99) / 1000.0 << " ms";
+					std::cout << "|" << std::left << std::setw(36) << latency.str() << std::right << "|" << std::endl;
+				}
+				noConnections = false;
+			}
+		}
+		if (noConnections) {
+			std::cout << "| No connections                     |\n";
+		}
+		printNavFooter();
+	}
+
+	// Print latency percentiles of every connection
+	void
+	printLatencyMetrics()
+	{
+		std::shared_ptr<const ConnectionSnapshot> connections = getConnections();
+		const std::string *channelList = connections->channelList;
+		bool noConnections = true;
+		std::cout
+		<< " ____________________________________\n"
+		<< "|      ----- Latency (ms) -----      |\n"
+		<< "|                                    |\n";
+		for (int i = 0; i < MAX_CHANNELS; i++)
+		{
+			if (channelList[i] == "")
+			{
+				continue;
+			}
+			noConnections = false;
+			LatencyHistogram& histogram = m_latency[i];
+			std::ostringstream name;
+			name << " Channel " << i << ": " << channelList[i];
+			std::cout << "|" << std::left << std::setw(36) << name.str() << std::right << "|" << std::endl;
+			if (histogram.getCount() == 0)
+			{
+				std::cout << "|   No samples                       |\n";
+				continue;
+			}
+			std::ostringstream line1, line2;
+			line1 << std::fixed << std::setprecision(1)
+				  << "   n " << histogram.getCount()
+				  << "  p50 " << histogram.getPercentile(50) / 1000.0
+				  << "  p90 " << histogram.getPercentile(90) / 1000.0;
+			line2 << std::fixed << std::setprecision(1)
+				  << "   p99 " << histogram.getPercentile(99) / 1000.0
+				  << "  p99.9 " << histogram.getPercentile(99.9) / 1000.0
+				  << "  max " << histogram.getMax() / 1000.0;
+			std::cout << "|" << std::left << std::setw(36) << line1.str() << std::right << "|" << std::endl;
+			std::cout << "|" << std::left << std::setw(36) << line2.str() << std::right << "|" << std::endl;
+		}
+		if (noConnections) {
+			std::cout << "| No connections                     |\n";
+		}
+		printNavFooter();
+	}
+
+	// Write latency percentiles of every connection to path every
+	// METRICS_PERIOD_S, in Prometheus text format (e.g. for the node
+	// exporter textfile collector)
+	void
+	enableMetricsFile(const std::string& path)
+	{
+		m_metricsPath = path;
+	}
+
+	// Print footer for menus
+	void
+	printNavFooter()
+	{
+		std::cout 
+		<< "|                                    |\n"
+		<< "| Main Menu: m                       |\n"
+		<< "| Quit: q                            |\n"
+		<< "|____________________________________|\n"
+		<< std::endl
+		<< "Enter selection: ";
+	}
+
+	void
+	printAllowedDevices()
+	{
+		std::cout
+			<< " ____________________________________\n"
+			<< "|     ----- Allowed Devices ----     |\n"
+			<< "|                                    |\n";
+		if (!printRules(true))
+		{
+			std::cout << "| All Devices Allowed                |\n";;
+		}
+	}
+
+	void
+	printProhibitedDevices()
+	{
+		std::cout
+			<< " ____________________________________\n"
+			<< "|    ----- Prohibited Devices ----   |\n"
+			<< "|                                    |\n";
+		if (!printRules(false))
+		{
+			std::cout << "| No devices Prohibited              |\n";
+		}
+	}
+
+	// Print the allow or deny patterns of the access rules
+	// Returns false if there are none
+	bool
+	printRules(bool allow)
+	{
+		bool any = false;
+		for (const AclRule& rule : m_acl.getRules())
+		{
+			if (rule.allow != allow)
+			{
+				continue;
+			}
+			if (!any)
+			{
+				std::cout << (allow ? "| Allowed Devices:                   |\n"
+									: "| Prohibited Devices:                |\n");
+				any = true;
+			}
+			std::cout << "|     " << rule.pattern;
+			int spaces = 31 - rule.pattern.size();
+			for (int i = 0; i < spaces; i++) {
+				std::cout << " ";
+			}
+			std::cout << "|" << std::endl;
+		}
+		return any;
+	}
+
+	// Reload access rules and transforms from file, keeping existing connections
+	void
+	reloadAccessRules()
+	{
+		if (m_acl.reload())
+		{
+			std::cout << "\nAccess rules reloaded." << std::endl;
+		}
+		if (m_transforms.reload())
+		{
+			std::cout << "Transforms reloaded." << std::endl;
+		}
+	}
+
+	void
+	printVerboseMode()
+	{
+		std::cout << std::endl;
+		if (verboseMode)
+		{
+			std::cout << "Verbose mode on. ";
+		}
+		else
+		{
+			std::cout << "Verbose mode off. ";
+		}
+		std::cout << std::endl;
+	}
+
+	// Clear all connections from another thread, on the face thread
+	void
+	requestClearAllConnections()
+	{
+		m_face.getIoService().post(std::bind(&PlaybackModule::clearAllConnections, this));
+	}
+
+	// Clear all connections to external controllers
+	void
+	clearAllConnections()
+	{
+		m_lookup.clear();
+		m_streams.clear();
+		for (int i = 0; i < MAX_CHANNELS; i++)
+		{
+			if (channelList[i] != "")
+			{
+				closeConnection(channelList[i]);
+			}
+			this->channelList[i] = "";
+			m_checkpoint.remove(i);
+		}
+		publishConnections();
+		printConnections();
+	}
+
+	// Pace output to a link of baudRate, e.g. a 5-pin DIN port
+	void
+	enableOutputShaping(unsigned int baudRate, bool runningStatus = false)
+	{
+		m_shaper.reset(new OutputShaper([this] (std::vector<unsigned char>* msg) {
+			NDNMIDI_TRACE3(send_message, (*msg)[0], msg->size(), umpClockMicros());
+			midiout->sendMessage(msg);
+		}, baudRate, runningStatus));
+	}
+
+	// Delay output to line up with the slowest port in the latency table
+	void
+	enableLatencyCompensation(const PortLatencyTable& latencies, const std::string& portName)
+	{
+		long delayUs = latencies.compensation(portName);
+		std::cerr << "Output latency compensation for " << portName << ": "
+				  << delayUs << " us" << std::endl;
+		if (delayUs <= 0)
+		{
+			return;
+		}
+		m_outputDelay = std::chrono::microseconds(delayUs);
+		startScheduler();
+	}
+
+	// Also express data Interests over face, e.g. one connected to
+	// another forwarder; it must run on the same io_service
+	// Returns false if there are MAX_PATHS already
+	bool
+	addPath(ndn::Face& face)
+	{
+		size_t path = m_pathCount.load();
+		if (path == MAX_PATHS)
+		{
+			return false;
+		}
+		m_paths[path] = &face;
+		m_pathCount = path + 1;
+		return true;
+	}
+
+	// Messages waiting for the output port
+	size_t
+	getQueueDepth()
+	{
+		std::shared_ptr<PlayoutScheduler> scheduler = std::atomic_load(&m_scheduler);
+		return (scheduler ? scheduler->getQueueDepth() : 0)
+			+ (m_shaper ? m_shaper->getQueueDepth() : 0);
+	}
+
+	// Checkpoint connection state to stateFile
+	// Connections found in a recent stateFile are resumed
+	bool
+	enableCheckpoint(const std::string& stateFile)
+	{
+		if (!m_checkpoint.open(stateFile))
+		{
+			return false;
+		}
+
+		bool resume = m_checkpoint.age() <= MAX_RESUME_AGE_S;
+		for (int i = 0; i < MAX_CHANNELS; i++)
+		{
+			const CheckpointSlot& slot = m_checkpoint.get(i);
+			if (!slot.inUse)
+			{
+				continue;
+			}
+			if (!resume)
+			{
+				m_checkpoint.remove(i);
+				continue;
+			}
+
+			std::string remoteName(slot.remoteName, strnlen(slot.remoteName, CHECKPOINT_NAME_SIZE));
+			if (slot.minSeqNo < 0 || slot.maxSeqNo < slot.minSeqNo
+				|| slot.maxSeqNo - slot.minSeqNo > CHECKPOINT_MAX_WINDOW)
+			{
+				std::cerr << "Not resuming " << remoteName << ": bad seq range ("
+						  << slot.minSeqNo << "," << slot.maxSeqNo << ")" << std::endl;
+				m_checkpoint.remove(i);
+				continue;
+			}
+			std::cerr << "Resuming connection: " << remoteName
+					  << " on channel " << i
+					  << " at seq " << slot.minSeqNo << std::endl;
+			channelList[i] = remoteName;
+			m_lookup[remoteName] = {slot.minSeqNo, slot.maxSeqNo, 0, i};
+			m_lookup[remoteName].received = slot.received;
+			m_lookup[remoteName].acks = true;
+			m_lookup[remoteName].retxSeqNo = -1;
+
+			// Re-express the Interests that were outstanding
+			expressMissing(remoteName);
+		}
+		publishConnections();
+		m_checkpoint.touch();
+		return true;
+	}
+
+	// Interface to set allowed and prohibited devices
+	void
+	specifyConnections()
+	{
+			std::cout << "\nWould you like to specify which devices can connect? [y/N] ";
+
+			std::string keyHit;
+			std::string keyHit2;
+	  		std::getline( std::cin, keyHit);
+			while ( keyHit == "y" ) {
+				std::cout << "\nEnter device name: ";
+				std::getline( std::cin, keyHit2);
+				m_acl.addRule(true, keyHit2);
+				std::cout << "\nWould you like to specify another device? [y/N] ";
+				std::getline( std::cin, keyHit); 
+	  		}
+
+	  		std::cout << "\nWould you like to specify which devices are prohibited? [y/N] ";
+
+	  		std::getline( std::cin, keyHit);
+			while ( keyHit == "y" ) {
+				std::cout << "\nEnter device name: ";
+				std::getline( std::cin, keyHit2);
+				m_acl.addRule(false, keyHit2);
+				std::cout << "\nWould you like to specify another device? [y/N] ";
+				std::getline( std::cin, keyHit); 
+	  		}
+
+	}
+
+	// Kind of a control Interest, the component after the device name:
+	// heartbeat[/<stream id>], standby, release, probe/<n> or
+	// takeover/<seqNo>[/<stream id>]; "" for anything else
+	// kindIndex is set to the (negative) index of the kind component
+	static std::string
+	controlKind(const ndn::Name& name, ssize_t *kindIndex = NULL)
+	{
+		for (ssize_t i = -1; i >= -3 && (size_t)(-i) < name.size(); --i)
+		{
+			std::string kind = name.get(i).toUri();
+			if (kind == "heartbeat" || kind == "standby" || kind == "release"
+				|| kind == "probe" || kind == "takeover")
+			{
+				if (kindIndex != NULL)
+				{
+					*kindIndex = i;
+				}
+				return kind;
+			}
+		}
+		return "";
+	}
+
+	// Respond to interest as heartbeat message or connection setup, or as
+	// one of a controller's failover control Interests
+	void
+	onInterest(const ndn::Interest& interest)
+	{
+		// Check if interest is for heartbeat/connection setup or throw away
+		ssize_t kindIndex = 0;
+		std::string kind = controlKind(interest.getName(), &kindIndex);
+		if (kind == "")
+			return;
+
+		// Get name of remote sending device
+		std::string remoteName = interest.getName().get(kindIndex - 1).toUri();
+		NDNMIDI_TRACE3(control, kind.c_str(), remoteName.c_str(), umpClockMicros());
+
+		// Probes only tell whether the connection is alive here
+		if (kind == "probe")
+		{
+			answerProbe(interest, remoteName);
+			return;
+		}
+
+		// Check if device is allowed and not prohibited
+		// Close connection if not
+		AclVerdict verdict = m_acl.check(remoteName);
+		if (verdict != ACL_ALLOWED)
+		{
+			if (!viewingMenu)
+			{
+				if (verdict == ACL_NOT_ALLOWED)
+				{
+					std::cerr << "Connection denied: Device not allowed: " << remoteName << std::endl;
+				}
+				else
+				{
+					std::cerr << "Connection denied: Device prohibited." << remoteName << std::endl;
+				}
+			}
+			closeConnection(remoteName);
+			return;
+		}
+
+		// We are a standby of remoteName: stay silent, and drop a connection
+		// left from an earlier turn as its primary or from the state file
+		if (kind == "standby")
+		{
+			if (m_lookup.count(remoteName) > 0)
+			{
+				std::cerr << "Now standby, closing connection: " << remoteName << std::endl;
+				removeConnection(remoteName);
+			}
+			putReply(interest.getName(), "STANDBY " + std::to_string(umpClockMicros()));
+			return;
+		}
+
+		// The controller failed over to another module while we were alive
+		if (kind == "release")
+		{
+			if (m_lookup.count(remoteName) > 0)
+			{
+				std::cerr << "Released by controller: " << remoteName << std::endl;
+				removeConnection(remoteName);
+			}
+			return;
+		}
+
+		if (kind == "takeover")
+		{
+			takeOver(interest, remoteName, kindIndex == -3 ? interest.getName().get(-1).toNumber() : 0);
+			return;
+		}
+
+		// Short names proposed by the controller
+		uint64_t streamId = kindIndex == -2 ? interest.getName().get(-1).toNumber() : 0;
+
+		// Check if connection already exist
+		bool isHeartbeat = false;
+		std::string content = "ACCEPTED";
+
+		// Check if connection already exists
+		if (m_lookup.count(remoteName) > 0)
+		{
+			if (verboseMode && !viewingMenu) {
+				std::cerr << "Received heartbeat message: " << interest << std::endl;
+			}
+			isHeartbeat = true;
+			m_lookup[remoteName].inactiveTime = 0;
+
+			// A controller restarted within the inactivity window proposes
+			// a new stream id; confirm it with a full handshake reply
+			if (kindIndex == -2 && remapStream(remoteName, streamId))
+			{
+				content = acceptedReply(remoteName);
+			}
+			else
+			{
+				// Answer with the pre-signed reply
+				HeartbeatReply& cached = m_heartbeatReply[m_lookup[remoteName].channel];
+				if (cached.data && cached.data->getName() == interest.getName())
+				{
+					m_face.put(*cached.data);
+					return;
+				}
+			}
+		}
+
+		// Accept and create new connection
+		if (!isHeartbeat)
+		{
+			if (!createConnection(remoteName, 0, streamId))
+			{
+				content = "DENIED";
+			}
+			else
+			{
+				// Only sent here, heartbeat replies are cached
+				content = acceptedReply(remoteName);
+				if (verboseMode && !viewingMenu && m_lookup[remoteName].streamId != 0)
+				{
+					std::cerr << "Short names " << shortStreamPrefix(streamId) << " for " << remoteName << std::endl;
+				}
+				if (verboseMode && !viewingMenu)
+				{
+					std::cerr << "Connection accepted: " << interest << std::endl;
+				}
+			}
+		}
+
+		/*** Respond to connection request ***/
+		std::shared_ptr<ndn::Data> data = putReply(interest.getName(), content);
+
+		if (isHeartbeat)
+		{
+			HeartbeatReply cached = {data, std::chrono::steady_clock::now()};
+			m_heartbeatReply[m_lookup[remoteName].channel] = cached;
+		}
+		else
+		{
+			SLEEP(20);
+			// "Prewarm the channel" with some interest packets to avoid initial playback latency
+			for (unsigned int i = 0; i < getTuning()->prewarm; ++i)
+			{
+				requestNext(remoteName);
+			}
+		}
+	}
+
+	// Group session: follow the stream of remoteName, whose latest
+	// sequence number is latestSeqNo, as if it had connected
+	// Hearing from an existing member keeps its connection alive
+	void
+	followStream(const std::string& remoteName, uint64_t latestSeqNo)
+	{
+		if (m_lookup.count(remoteName) > 0)
+		{
+			m_lookup[remoteName].inactiveTime = 0;
+			return;
+		}
+
+		if (m_acl.check(remoteName) != ACL_ALLOWED)
+		{
+			return;
+		}
+
+		// Start after the latest published packet instead of replaying
+		if (!createConnection(remoteName, static_cast<int>(latestSeqNo) + 1))
+		{
+			return;
+		}
+		// Every member fetches the same names, so the network can
+		// aggregate their Interests
+		m_lookup[remoteName].acks = false;
+		std::cerr << "Following group member: " << remoteName << std::endl;
+		for (unsigned int i = 0; i < getTuning()->prewarm; ++i)
+		{
+			requestNext(remoteName);
+		}
+	}
+
+private:
+	// Assign the first available channel to remoteName and create its
+	// control block starting at firstSeqNo, fetching short names if a
+	// streamId is given and no other stream uses it
+	// Returns false if no channel is available
+	bool
+	createConnection(const std::string& remoteName, int firstSeqNo, uint64_t streamId = 0)
+	{
+		int controllerChannel = MAX_CHANNELS;
+		// Set channel to first available channel
+		for (int i = 0; i < MAX_CHANNELS; i++) 
+		{
+			if (channelList[i] == "") {
+				controllerChannel = i;
+				channelList[i] = remoteName;
+				break;
+			}
+		}
+
+		// Return error if no availble channels
+		if (controllerChannel == MAX_CHANNELS) {
+			std::cerr << "Connection denied: No available MIDI channels." << std::endl;
+			return false;
+		}
+
+		// Create MIDI control block for new connection
+		m_lookup[remoteName] = {firstSeqNo,firstSeqNo,0,controllerChannel};
+		m_lookup[remoteName].acks = true;
+		m_lookup[remoteName].retxSeqNo = -1;
+		if (streamId != 0 && m_streams.count(streamId) == 0)
+		{
+			m_lookup[remoteName].streamId = streamId;
+			m_streams[streamId] = remoteName;
+		}
+		m_latency[controllerChannel].reset();
+		m_heartbeatReply[controllerChannel] = HeartbeatReply();
+		m_checkpoint.open(controllerChannel, remoteName, firstSeqNo, firstSeqNo);
+		publishConnections();
+		return true;
+	}
+
+	// Fetch remoteName under the newly proposed streamId, or full names if
+	// another stream uses it, and re-express the outstanding Interests,
+	// which nobody answers under the old id
+	// Returns false if nothing changed
+	bool
+	remapStream(const std::string& remoteName, uint64_t streamId)
+	{
+		MIDIControlBlock& cb = m_lookup[remoteName];
+		if (streamId == cb.streamId || (cb.streamId == 0 && m_streams.count(streamId) > 0))
+		{
+			return false;
+		}
+		m_streams.erase(cb.streamId);
+		cb.streamId = 0;
+		if (streamId != 0 && m_streams.count(streamId) == 0)
+		{
+			cb.streamId = streamId;
+			m_streams[streamId] = remoteName;
+		}
+		std::cerr << "New stream id " << streamId << " for " << remoteName << std::endl;
+		expressMissing(remoteName);
+		return true;
+	}
+
+	// Express the Interests of remoteName's window that have not been
+	// answered yet
+	void
+	expressMissing(const std::string& remoteName)
+	{
+		const MIDIControlBlock& cb = m_lookup[remoteName];
+		for (int seqNo = cb.minSeqNo; seqNo < cb.maxSeqNo; ++seqNo)
+		{
+			int offset = seqNo - cb.minSeqNo;
+			if (offset >= 64 || !((cb.received >> offset) & 1))
+			{
+				expressData(remoteName, seqNo);
+			}
+		}
+	}
+
+	// Forget the connection with remoteName and free its channel
+	void
+	removeConnection(const std::string& remoteName)
+	{
+		m_streams.erase(m_lookup[remoteName].streamId);
+		channelList[m_lookup[remoteName].channel] = "";
+		m_checkpoint.remove(m_lookup[remoteName].channel);
+		m_lookup.erase(remoteName);
+		publishConnections();
+	}
+
+	// Replace the snapshot read by the menu, metrics and monitor threads
+	void
+	publishConnections()
+	{
+		std::shared_ptr<ConnectionSnapshot> connections = std::make_shared<ConnectionSnapshot>();
+		for (int i = 0; i < MAX_CHANNELS; i++)
+		{
+			connections->channelList[i] = channelList[i];
+		}
+		connections->count = m_lookup.size();
+		std::atomic_store(&m_connections, std::shared_ptr<const ConnectionSnapshot>(connections));
+	}
+
+	// Handshake reply of an accepted connection
+	// Our clock lets the controller timestamp in it, filtered messages
+	// need not be sent at all, and the stream id confirms short names
+	std::string
+	acceptedReply(const std::string& remoteName)
+	{
+		return "ACCEPTED " + std::to_string(umpClockMicros())
+			+ " " + m_transforms.get(remoteName)->statusFilterHex()
+			+ " " + std::to_string(m_lookup[remoteName].streamId);
+	}
+
+	// Sign and put a reply to a control Interest
+	std::shared_ptr<ndn::Data>
+	putReply(const ndn::Name& name, const std::string& content)
+	{
+		// Create data packet with the same name as the interest packet
+		std::shared_ptr<ndn::Data> data = std::make_shared<ndn::Data>(name);
+
+		// Prepare and assign content of the data packet
+		data->setContent(reinterpret_cast<const uint8_t*>(content.c_str()), content.size());
+
+		// Set metainfo parameters
+		data->setFreshnessPeriod(ndn::time::seconds(1));
+
+		// Sign data packet
+		m_keyChain.sign(*data);
+
+		// Make data packet available for fetching
+		m_face.put(*data);
+		return data;
+	}
+
+	// Report the oldest packet of remoteName's stream not received yet,
+	// "ALIVE <seqNo>": everything before it has been played, which is
+	// where a standby resumes if the controller has to fail over
+	// Probes come many times a second: the reply is only digest-signed, and
+	// never fresh so a content store cannot answer for a dead module
+	void
+	answerProbe(const ndn::Interest& interest, const std::string& remoteName)
+	{
+		std::map<std::string, MIDIControlBlock>::iterator it = m_lookup.find(remoteName);
+		if (it == m_lookup.end())
+		{
+			return;
+		}
+		it->second.inactiveTime = 0;
+		std::string content = "ALIVE " + std::to_string(it->second.minSeqNo);
+		std::shared_ptr<ndn::Data> data = std::make_shared<ndn::Data>(interest.getName());
+		data->setContent(reinterpret_cast<const uint8_t*>(content.c_str()), content.size());
+		data->setFreshnessPeriod(ndn::time::milliseconds(0));
+		m_keyChain.sign(*data, ndn::security::signingWithSha256());
+		m_face.put(*data);
+	}
+
+	// Take over from a controller's failed primary module, starting at the
+	// first packet it had not played (takeover/<seqNo>[/<stream id>])
+	// No pause before prewarming: the controller is already connected
+	void
+	takeOver(const ndn::Interest& interest, const std::string& remoteName, uint64_t streamId)
+	{
+		int firstSeqNo = interest.getName().get(streamId != 0 ? -2 : -1).toSequenceNumber();
+		if (m_lookup.count(remoteName) > 0)
+		{
+			removeConnection(remoteName);
+		}
+		if (!createConnection(remoteName, firstSeqNo, streamId))
+		{
+			putReply(interest.getName(), "DENIED");
+			return;
+		}
+		putReply(interest.getName(), acceptedReply(remoteName));
+		std::cerr << "Taking over " << remoteName << " at packet " << firstSeqNo << std::endl;
+		for (unsigned int i = 0; i < getTuning()->prewarm; ++i)
+		{
+			requestNext(remoteName);
+		}
+	}
+
+	// path is the index of the Face the data came over
+	void
+	onData(const ndn::Data& data, size_t path)
+	{
+		// Exit is data packet is a heartbeat message
+		if (data.getName().get(-1).toUri() == "heartbeat")
+			return;
+
+		// Get sequence number of data packet
+		int seqNo = data.getName().get(-1).toSequenceNumber();
+		NDNMIDI_TRACE4(data, seqNo, data.getContent().value_size(), umpClockMicros(), path);
+
+		// Set name of remote MIDI controller from data packet
+		std::string remoteName;
+		if (isShortStreamName(data.getName()))
+		{
+			std::map<uint64_t, std::string>::iterator stream = m_streams.find(data.getName().get(1).toNumber());
+			if (stream != m_streams.end())
+			{
+				remoteName = stream->second;
+			}
+		}
+		else
+		{
+			remoteName = data.getName().get(1).toUri();
+		}
+
+		// Verify connection exists
+		if (m_lookup.count(remoteName) == 0)
+		{
+			// the connection doesn't exist!!
+			std::cerr << "Connection for remote user \""
+					  << remoteName << "\" doesn't exist!"
+					  << std::endl;
+			return;
+		}
+
+		// Possibly for future: CHECKPOINT 2: sequence number agrees
+		//if (m_lookup[remoteName].minSeqNo >= m_lookup[remoteName].maxSeqNo)
+		//{
+		//	// behavior yet to be defined......
+		//	std::cerr << "Corrupted block: minSeqNo >= maxSeqNo"
+		//			  << std::endl;
+		//}
+		//if (m_lookup[remoteName].minSeqNo != seqNo)
+		//{
+		//	// behavior yet to be defined
+		//	std::cerr << "Sequence number out of order --> "
+		//			  << "sent: " << m_lookup[remoteName].minSeqNo
+		//			  << "  rcvd: " << seqNo
+		//			  << std::endl;
+		//}
+
+		const uint8_t *content = data.getContent().value();
+		int dataSize = data.getContent().value_size();
+		if (dataSize > MAX_PACKET_SIZE)
+		{
+			dataSize = MAX_PACKET_SIZE;
+		}
+		// Possibly got future:
+		// if (data.getContent().value_size() != 3)
+		// {
+		// 	// incorrect data format
+		// 	// behavior yet to be defined
+		// 	std::cerr << "Incorrect data format: len = "
+		// 			  << data.getContent().value_size()
+		// 			  << " (expected 3)"
+		// 			  << std::endl;
+		// }
+
+		// Get connection information
+		MIDIControlBlock cb = m_lookup[remoteName];
+
+		// Check for valid sequence number
+		if (cb.maxSeqNo < seqNo)
+		{
+			if (verboseMode && !viewingMenu)
+			{
+				std::cerr << "Received packet w/ seq# somehow larger than "
+						  << "expected max value: " << seqNo
+						  << " (" << cb.maxSeqNo << ")" << std::endl;
+			}
+			return;
+		}
+
+		// Play the first copy only, whichever path it came over
+		if (!m_lookup[remoteName].markReceived(seqNo))
+		{
+			if (verboseMode && !viewingMenu)
+			{
+				std::cerr << "Received duplicate or out-of-date packet... Dropped" << std::endl;
+			}
+			return;
+		}
+		++m_pathWins[path];
+		MIDIControlBlock& block = m_lookup[remoteName];
+		m_checkpoint.update(block.channel, block.minSeqNo, block.maxSeqNo, block.received);
+
+		// Ask again, once, for a packet overtaken by LOSS_REORDER_PACKETS
+		// later ones; its Interest may never be answered otherwise
+		if (block.received != 0 && block.retxSeqNo != block.minSeqNo
+			&& seqNo - block.minSeqNo >= LOSS_REORDER_PACKETS)
+		{
+			block.retxSeqNo = block.minSeqNo;
+			expressData(remoteName, block.minSeqNo);
+		}
+
+		// Create MIDI message for playback from data packet
+		std::string receivedData = "Received data:";
+		//std::cout << "Received data:";
+		// Decode the whole packet at once: byte order, channel
+		// assignment, status validation and shutdown detection
+		uint32_t words[MAX_PACKET_SIZE / 4];
+		size_t wordCount = dataSize / 4;
+		unsigned int batchFlags = m_batchDecode(content, wordCount, cb.channel, words);
+
+		// The batch decoder takes data words of multi-word messages for
+		// messages, so walk those packets one message at a time
+		if (batchFlags & BATCH_IRREGULAR)
+		{
+			batchFlags = batchDecodeMessages(content, wordCount, cb.channel, words);
+		}
+
+		// Transpose, route and filter for this player before anything plays
+		std::shared_ptr<const CompiledTransform> transform = m_transforms.get(remoteName);
+		if (!transform->identity)
+		{
+			wordCount = transform->apply(words, wordCount, batchFlags & BATCH_IRREGULAR);
+		}
+
+		UMPMessage ump;
+		unsigned char bytes[3];
+		uint64_t now = umpClockMicros();
+		// Send time of the next message, and its play time if ahead of time
+		uint64_t stampUs = now;
+		uint64_t playAtUs = 0;
+		for (size_t j = 0; j < wordCount; ){
+			// Regular packets only hold single-word messages
+			unsigned int msgWords = (batchFlags & BATCH_IRREGULAR) ? umpWordCount(words[j]) : 1;
+			if (j + msgWords > wordCount)
+			{
+				break;
+			}
+			memcpy(ump.word, words + j, 4 * msgWords);
+			j += msgWords;
+
+			// Special UMP message for shutdown
+			// TODO: Implement a way to send this message 
+			if ((batchFlags & BATCH_SHUTDOWN) && ump.word[0] == UMP_SHUTDOWN)
+			{
+				std::cerr << "Deleting table entry of: " << remoteName << std::endl;
+				removeConnection(remoteName);
+				return;
+			}
+
+			// Capture time of the next message
+			if (umpIsJRTimestamp(ump.word[0]))
+			{
+				stampUs = umpJRTimestampTime(ump.word[0], now);
+				m_latency[cb.channel].record(now - stampUs);
+				continue;
+			}
+			if (umpIsPlayAt(ump.word[0]))
+			{
+				playAtUs = stampUs + umpPlayAtLeadUs(ump.word[0]);
+				continue;
+			}
+
+			// Convert for RtMidi
+			size_t nBytes = umpToMIDI1(ump.word, bytes);
+			if (nBytes == 0)
+			{
+				continue;
+			}
+
+			receivedData = receivedData + " [" + std::to_string((bytes[0] >> 4) & 15);
+			for (size_t i = 1; i < nBytes; ++i)
+			{
+				receivedData = receivedData + " " + std::to_string((int)bytes[i]);
+			}
+			receivedData = receivedData + " Channel: " + std::to_string(cb.channel) + "]";
+
+			// Playback of MIDI message
+			if (playAtUs != 0)
+			{
+				playMessageAt(bytes, nBytes, playAtUs, now);
+				playAtUs = 0;
+			}
+			else
+			{
+				playMessage(bytes, nBytes);
+			}
+		}
+		
+		// Print sequence range
+		receivedData = receivedData + "\t[seq range = (" + std::to_string(m_lookup[remoteName].minSeqNo) + "," + std::to_string(m_lookup[remoteName].maxSeqNo) + ")]\n";
+		// std::cout << "\t[seq range = (" << m_lookup[remoteName].minSeqNo
+		// 	<< "," << m_lookup[remoteName].maxSeqNo << ")]" << std::endl;
+		if (!getViewingMenu())
+		{
+			std::cout << receivedData;
+		}
+		// Keep the window of outstanding Interests full
+		requestNext(remoteName);
+	}
+
+	
+	void
+	onTimeout(const ndn::Interest& interest)
+	{
+		// For future: Possibly more than a message
+		if (verboseMode && !viewingMenu)
+		{
+			std::cerr << "Timeout for: " << interest << std::endl;
+		}
+		//m_face.expressInterest(interest,
+		//						std::bind(&PlaybackModule::onData, this, _2),
+		//						std::bind(&PlaybackModule::onTimeout, this, _1));
+	}
+
+	void 
+	onNack(const ndn::Interest& interest)
+	{
+		// For future: Possibly more than a message
+		if (verboseMode && !viewingMenu)
+		{
+			std::cerr << "Nack received for: " << interest << std::endl;
+		}
+	}
+	
+
+private:
+	// Play a MIDI message now, or after the latency compensation delay
+	void
+	playMessage(const unsigned char *bytes, size_t size)
+	{
+		if (m_scheduler)
+		{
+			m_scheduler->schedule(bytes, size, std::chrono::steady_clock::now() + m_outputDelay);
+			return;
+		}
+		sendToPort(bytes, size);
+	}
+
+	// Play a MIDI message sent ahead of time at playAtUs (umpClockMicros()),
+	// or at once if that has passed
+	void
+	playMessageAt(const unsigned char *bytes, size_t size, uint64_t playAtUs, uint64_t nowUs)
+	{
+		if (!m_scheduler)
+		{
+			startScheduler();
+		}
+		std::chrono::microseconds lead(playAtUs > nowUs ? playAtUs - nowUs : 0);
+		m_scheduler->schedule(bytes, size, std::chrono::steady_clock::now() + lead + m_outputDelay);
+	}
+
+	// Route all output through the playout scheduler from now on, so
+	// messages keep their order on the port
+	void
+	startScheduler()
+	{
+		std::atomic_store(&m_scheduler, std::make_shared<PlayoutScheduler>([this] (const unsigned char *bytes, size_t size) {
+			sendToPort(bytes, size);
+		}));
+	}
+
+	// Send a MIDI message to the output port, through the shaper if enabled
+	void
+	sendToPort(const unsigned char *bytes, size_t size)
+	{
+		if (m_shaper)
+		{
+			m_shaper->enqueue(bytes, size);
+			return;
+		}
+		this->message.assign(bytes, bytes + size);
+		NDNMIDI_TRACE3(send_message, bytes[0], size, umpClockMicros());
+		this->midiout->sendMessage(&this->message);
+	}
+
+	void
+	requestNext(std::string remoteName)
+	{
+		// Check if connection exists
+		if (m_lookup.count(remoteName) == 0)
+		{
+			if (verboseMode && !viewingMenu)
+			{
+				std::cerr << "Attempted to request from non-existent remote: "
+						  << remoteName
+						  << " - DROPPED"
+						  << std::endl;
+			}
+			return;
+		}
+
+		int nextSeqNo = m_lookup[remoteName].maxSeqNo;
+		
+		// Possible implementation without specifying interest lifetime
+		/** Send interest without specifying interest lifetime 
+
+		ndn::Name nextName = ndn::Name(m_baseName).appendSequenceNumber(nextSeqNo);
+		m_face.expressInterest(ndn::Interest(nextName).setMustBeFresh(true),
+								std::bind(&PlaybackModule::onData, this, _2),
+								std::bind(&PlaybackModule::onTimeout, this, _1));
+		**/
+
+		NDNMIDI_TRACE3(request_next, nextSeqNo, m_lookup[remoteName].streamId, umpClockMicros());
+		expressData(remoteName, nextSeqNo);
+
+		// Increment max sequence number 
+		m_lookup[remoteName].maxSeqNo++;
+		const MIDIControlBlock& cb = m_lookup[remoteName];
+		m_checkpoint.update(cb.channel, cb.minSeqNo, cb.maxSeqNo, cb.received);
+
+		//std::cerr << "Sending out interest: " << nextName << std::endl;
+	}
+
+	// Express the Interest for packet seqNo of remoteName, with a long
+	// lifetime: <prefix>[/<ack>]/<seqNo>, where the cumulative ack is the
+	// first packet not received yet
+	void
+	expressData(const std::string& remoteName, int seqNo)
+	{
+		const MIDIControlBlock& cb = m_lookup[remoteName];
+		ndn::Name name = cb.streamId != 0 ? shortStreamPrefix(cb.streamId)
+				: ndn::Name("/topo-prefix/" + remoteName + "/midi-ndn/" + m_projName);
+		if (cb.acks)
+		{
+			name.appendNumber(cb.minSeqNo);
+		}
+		name.appendSequenceNumber(seqNo);
+		ndn::Interest interest = ndn::Interest(name);
+		interest.setInterestLifetime(ndn::time::seconds(getTuning()->interestLifetimeS));
+		interest.setMustBeFresh(true);
+		// Same Interest over every path, each Face adds its own nonce
+		for (size_t path = 0; path < m_pathCount.load(); ++path)
+		{
+			m_paths[path]->expressInterest(interest,
+									std::bind(&PlaybackModule::onData, this, _2, path),
+									std::bind(&PlaybackModule::onNack, this, _1),
+									std::bind(&PlaybackModule::onTimeout, this, _1));
+		}
+	}
+
+	// Close the connection with remoteName
+	private:
+	void
+	closeConnection(std::string remoteName)
+	{
+		// Create and send next interest with long interest lifetime
+		ndn::Name nextName = ndn::Name("/topo-prefix/" + remoteName + "/midi-ndn/" + m_projName + "/shutdown");
+		ndn::Interest nextNameInterest = ndn::Interest(nextName);
+		nextNameInterest.setInterestLifetime(ndn::time::seconds(10));
+		nextNameInterest.setMustBeFresh(true);
+		m_face.expressInterest(nextNameInterest,
+								std::bind(&PlaybackModule::onData, this, _2, 0),
+								std::bind(&PlaybackModule::onNack, this, _1),
+								std::bind(&PlaybackModule::onTimeout, this, _1));
+
+	}
+
+	// Check and update/remove all control blocks every second
+	void
+	controlBlockMonitoring()
+	{
+		std::unique_lock<std::mutex> lock(m_monitorMutex);
+		while (!m_monitorWake.wait_for(lock, std::chrono::seconds(1), [this] { return m_monitorStop; }))
+		{
+			lock.unlock();
+			monitorTick();
+			lock.lock();
+		}
+	}
+
+public:
+	// Age all control blocks by one second and remove stale ones on the
+	// face thread, and write the metrics file on this one
+	void
+	monitorTick()
+	{
+		m_face.getIoService().post(std::bind(&PlaybackModule::ageConnections, this));
+
+		if (!m_metricsPath.empty() && ++m_metricsTick % METRICS_PERIOD_S == 0)
+		{
+			writeMetrics();
+		}
+	}
+
+private:
+	void
+	ageConnections()
+	{
+		std::vector<std::string> rmList;
+		for (std::map<std::string, MIDIControlBlock>::iterator it = m_lookup.begin();
+			it != m_lookup.end(); ++it)
+		{
+			if (++it->second.inactiveTime > (int)getTuning()->maxInactiveS)
+			{
+				rmList.push_back(it->first);
+			}
+		}
+
+		for (std::string& remoteName : rmList)
+		{
+			std::cerr << "Deleting connection because it is not active: "
+					  << remoteName << std::endl;
+			removeConnection(remoteName);
+		}
+		m_checkpoint.touch();
+		refreshHeartbeatReplies();
+	}
+
+	// Re-sign old heartbeat replies and drop those of closed connections
+	// so answering a heartbeat never has to sign
+	void
+	refreshHeartbeatReplies()
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		for (int i = 0; i < MAX_CHANNELS; i++)
+		{
+			HeartbeatReply& cached = m_heartbeatReply[i];
+			if (!cached.data)
+			{
+				continue;
+			}
+			if (channelList[i] == "")
+			{
+				cached = HeartbeatReply();
+				continue;
+			}
+			if (now - cached.signedAt < std::chrono::seconds(HEARTBEAT_REPLY_MAX_AGE_S))
+			{
+				continue;
+			}
+			std::shared_ptr<ndn::Data> data = std::make_shared<ndn::Data>(cached.data->getName());
+			data->setContent(cached.data->getContent().value(), cached.data->getContent().value_size());
+			data->setFreshnessPeriod(ndn::time::seconds(1));
+			m_keyChain.sign(*data);
+			// Encode now rather than on the next put
+			data->wireEncode();
+			cached.data = data;
+			cached.signedAt = now;
+		}
+	}
+
+	// Replace the metrics file, so readers never see a partial one
+	void
+	writeMetrics()
+	{
+		std::shared_ptr<const ConnectionSnapshot> connections = getConnections();
+		std::string tmpPath = m_metricsPath + ".tmp";
+		std::ofstream out(tmpPath.c_str());
+		if (!out)
+		{
+			return;
+		}
+		static const double quantiles[] = {50, 90, 99, 99.9};
+		out << "# HELP ndnmidi_latency_us One-way latency from key press to arrival\n"
+			<< "# TYPE ndnmidi_latency_us summary\n";
+		for (int i = 0; i < MAX_CHANNELS; i++)
+		{
+			std::string player = connections->channelList[i];
+			if (player == "")
+			{
+				continue;
+			}
+			for (double q : quantiles)
+			{
+				out << "ndnmidi_latency_us{player=\"" << player << "\",quantile=\"" << q / 100 << "\"} "
+					<< m_latency[i].getPercentile(q) << "\n";
+			}
+			out << "ndnmidi_latency_us_count{player=\"" << player << "\"} " << m_latency[i].getCount() << "\n"
+				<< "ndnmidi_latency_us_max{player=\"" << player << "\"} " << m_latency[i].getMax() << "\n";
+		}
+		size_t pathCount = m_pathCount.load();
+		if (pathCount > 1)
+		{
+			out << "# HELP ndnmidi_path_first_data_total Packets whose first copy came over this path\n"
+				<< "# TYPE ndnmidi_path_first_data_total counter\n";
+			for (size_t path = 0; path < pathCount; ++path)
+			{
+				out << "ndnmidi_path_first_data_total{path=\"" << path << "\"} " << m_pathWins[path].load() << "\n";
+			}
+		}
+		out.close();
+		rename(tmpPath.c_str(), m_metricsPath.c_str());
+	}
+
+private:
+	ndn::Face& m_face;
+	ndn::KeyChain& m_keyChain;
+	ndn::Name m_baseName;
+	std::string m_projName;
+
+	// Allowed and prohibited devices
+	AccessControl m_acl;
+	EventTransforms m_transforms;
+	std::shared_ptr<const Tuning> m_tuning = std::make_shared<Tuning>();
+
+	// Faces data Interests are expressed over, m_face first, and how
+	// often each delivered a packet first
+	// Fixed size, as the metrics thread reads them while paths are added
+	ndn::Face* m_paths[MAX_PATHS];
+	std::atomic<size_t> m_pathCount;
+	std::atomic<unsigned long> m_pathWins[MAX_PATHS];
+
+	// Maps remote hostname (remoteName) to a control block
+	std::map<std::string, MIDIControlBlock> m_lookup;
+
+	// Maps stream ids of short names to remoteName
+	std::map<uint64_t, std::string> m_streams;
+
+	// Published copy of channelList for other threads
+	std::shared_ptr<const ConnectionSnapshot> m_connections = std::make_shared<ConnectionSnapshot>();
+
+	// Packet decoder chosen at startup
+	BatchDecodeFn m_batchDecode;
+
+	// Thread to monitor control blocks and add/remove as necessary
+	std::thread cbMonitor;
+	std::mutex m_monitorMutex;
+	std::condition_variable m_monitorWake;
+	bool m_monitorStop = false;
+
+	// List of MIDI channels
+	std::string channelList[16] = {};
+
+	// Persisted copy of m_lookup and channelList for warm restarts
+	StateCheckpoint m_checkpoint;
+
+	// Output pacing for slow links, if enabled
+	std::unique_ptr<OutputShaper> m_shaper;
+
+	// Output latency compensation and messages sent ahead of time, set
+	// on the face thread and read atomically elsewhere
+	std::shared_ptr<PlayoutScheduler> m_scheduler;
+	std::chrono::microseconds m_outputDelay = std::chrono::microseconds(0);
+
+	// One-way latency of each channel's connection
+	LatencyHistogram m_latency[MAX_CHANNELS];
+
+	// Pre-signed heartbeat reply of each channel's connection
+	HeartbeatReply m_heartbeatReply[MAX_CHANNELS];
+	std::string m_metricsPath;
+	int m_metricsTick = 0;
+
+	bool setupComplete = false;
+
+	bool viewingMenu = false;
+
+	bool verboseMode = false;
+
+public:
+	MidiOutput *midiout;
+	std::vector<unsigned char> message;
+};
+
+inline void
+printMenu()
+{
+	std::cout 
+		<< std::endl
+		<< " ____________________________________\n"
+		<< "|       ------ Main Menu ------      |\n"
+		<< "|                                    |\n"
+		<< "| View Connections: 0                |\n"
+		<< "| Clear Connections: 1               |\n"
+		<< "| Allowed Devices: 2                 |\n"
+		<< "| Prohibited Devices: 3              |\n"
+		<< "| Latency Metrics: 4                 |\n"
+		<< "| Reload Rules: r                    |\n"
+		<< "|                                    |\n"
+		<< "| Toggle verbose mode: v             |\n"
+		<< "| Exit: q                            |\n"
+		<< "|____________________________________|\n"
+		<< std::endl
+		<< "Please select an option: ";
+}
+
+inline void
+menuListener(PlaybackModule& playbackModule)
+{
+	while(playbackModule.getSetupComplete()) {
+		std::string listener = "";
+		char menuOption;
+		getline (std::cin, listener);
+		if (listener == "menu") {
+			playbackModule.setViewingMenu();
+			mainMenu:
+				printMenu();
+				//getline (std::cin, menuOption);
+				std::cin >> menuOption;
+				switch (menuOption) {
+					case '0' :
+						playbackModule.printConnections();
+						std::cin >> menuOption;
+						switch (menuOption) {
+							case 'm' :
+								goto mainMenu;
+							default :
+								break;
+						}
+						break;
+					case '1' :
+						playbackModule.requestClearAllConnections();
+						break;
+					case '2' :
+						playbackModule.printAllowedDevices();
+						playbackModule.printNavFooter();
+						std::cin >> menuOption;
+						switch (menuOption) {
+							case 'm' :
+								goto mainMenu;
+							default :
+								break;
+						}
+						break;
+					case '3' :
+						playbackModule.printProhibitedDevices();
+						playbackModule.printNavFooter();
+						std::cin >> menuOption;
+						switch (menuOption) {
+							case 'm' :
+								goto mainMenu;
+							default :
+								break;
+						}
+						break;
+					case '4' :
+						playbackModule.printLatencyMetrics();
+						std::cin >> menuOption;
+						switch (menuOption) {
+							case 'm' :
+								goto mainMenu;
+							default :
+								break;
+						}
+						break;
+					case 'r' :
+						playbackModule.reloadAccessRules();
+						goto mainMenu;
+					case 'v' :
+						playbackModule.toggleVerboseMode();
+						playbackModule.printVerboseMode();
+						goto mainMenu;
+					case 'm' :
+						goto mainMenu;
+					default :
+						break;
+
+				}
+			playbackModule.unsetViewingMenu();
+		}
+	}
+	return;
+}
+
+// Open the MIDI output port given by preset, or ask the user
+inline bool
+chooseMidiPort( MidiOutput *rtmidi, const std::string& preset, std::string *openedName = NULL )
+{
+  std::string virtualName = "NDN-MIDI Playback";
+  if ( openedName ) {
+    *openedName = virtualName;
+  }
+
+  // Port given on the command line: a number or "virtual"
+  if ( preset == "virtual" ) {
+    rtmidi->openVirtualPort( virtualName );
+    return true;
+  }
+  if ( !preset.empty() ) {
+    unsigned int port = atoi( preset.c_str() );
+    if ( openedName ) {
+      *openedName = rtmidi->getPortName( port );
+    }
+    rtmidi->openPort( port );
+    return true;
+  }
+
+  std::cout << "\nWould you like to open a virtual NDN-MIDI output port? [y/N] ";
+
+  std::string keyHit;
+  std::getline( std::cin, keyHit);
+  std::string keyHit2 = "NDN-MIDI Playback";
+  if ( keyHit == "y" ) {
+  	//std::cout << "Name your port: ";
+  	//std::getline( std::cin, keyHit2);
+    rtmidi->openVirtualPort(keyHit2);
+    return true;
+  }
+ 
+  std::string portName;
+  unsigned int i = 0, nPorts = rtmidi->getPortCount();
+  if ( nPorts == 0 ) {
+    std::cout << "No output ports available!" << std::endl;
+    return false;
+  }
+
+  if ( nPorts == 1 ) {
+    std::cout << "\nOpening " << rtmidi->getPortName() << std::endl;
+  }
+  else {
+    for ( i=0; i<nPorts; i++ ) {
+      portName = rtmidi->getPortName(i);
+      std::cout << "  Output port #" << i << ": " << portName << '\n';
+    }
+
+    do {
+      std::cout << "\nChoose a port number: ";
+      std::cin >> i;
+    } while ( i >= nPorts );
+  }
+
+  std::cout << "\n";
+  if ( openedName ) {
+    *openedName = rtmidi->getPortName( i );
+  }
+  rtmidi->openPort( i );
+
+  return true;
+}
+
+// Connect to each forwarder in a comma-separated list of host[:port]
+// and add it as a path of playbackModule, on face's io_service
+// The Faces are kept in faces
+inline void
+addPaths(PlaybackModule& playbackModule, ndn::Face& face, const std::string& list,
+		 std::vector<std::unique_ptr<ndn::Face> >& faces)
+{
+	std::istringstream entries(list);
+	std::string entry;
+	while (std::getline(entries, entry, ','))
+	{
+		std::string host = entry;
+		std::string port = "6363";
+		size_t colon = entry.rfind(':');
+		if (colon != std::string::npos)
+		{
+			host = entry.substr(0, colon);
+			port = entry.substr(colon + 1);
+		}
+		std::shared_ptr<ndn::Transport> transport = std::make_shared<ndn::TcpTransport>(host, port);
+		faces.emplace_back(new ndn::Face(transport, face.getIoService()));
+		if (!playbackModule.addPath(*faces.back()))
+		{
+			std::cerr << "At most " << MAX_PATHS - 1 << " redundant paths, ignoring " << entry << std::endl;
+			faces.pop_back();
+			return;
+		}
+		std::cerr << "Redundant path: " << host << ":" << port << std::endl;
+	}
+}
+
+#endif
@@ -0,0 +1,128 @@
+/********************************
+
+PlayoutScheduler.h
+
+Timed output of MIDI messages for PlaybackModuleMIDI
+
+Messages are queued with the time they should leave for the output
+port and handed to the send callback by a dedicated thread when that
+time comes. Messages due at the same time keep their order.
+
+********************************/
+
+#ifndef NDNMIDI_PLAYOUT_SCHEDULER_H
+#define NDNMIDI_PLAYOUT_SCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class PlayoutScheduler
+{
+public:
+	typedef std::function<void(const unsigned char*, size_t)> SendCallback;
+	typedef std::chrono::steady_clock::time_point TimePoint;
+
+	PlayoutScheduler(const SendCallback& send)
+		: m_send(send)
+		, m_nextOrder(0)
+		, m_stop(false)
+	{
+		m_thread = std::thread(&PlayoutScheduler::run, this);
+	}
+
+	~PlayoutScheduler()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_wakeup.notify_one();
+		m_thread.join();
+	}
+
+	// Queue a MIDI 1.0 message to be sent at due
+	void
+	schedule(const unsigned char *bytes, size_t size, TimePoint due)
+	{
+		bool first;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			Event event = {due, m_nextOrder++, std::vector<unsigned char>(bytes, bytes + size)};
+			m_events.push(event);
+			first = m_events.top().order == event.order;
+		}
+		// Only an earlier deadline changes what the thread waits for
+		if (first)
+		{
+			m_wakeup.notify_one();
+		}
+	}
+
+	// Messages waiting for their time
+	size_t
+	getQueueDepth()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_events.size();
+	}
+
+private:
+	struct Event
+	{
+		TimePoint due;
+		unsigned long order;
+		std::vector<unsigned char> bytes;
+
+		// Earliest first in the priority queue
+		bool
+		operator<(const Event& other) const
+		{
+			return due != other.due ? due > other.due : order > other.order;
+		}
+	};
+
+	void
+	run()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_stop)
+		{
+			if (m_events.empty())
+			{
+				m_wakeup.wait(lock);
+				continue;
+			}
+			TimePoint due = m_events.top().due;
+			if (std::chrono::steady_clock::now() < due)
+			{
+				m_wakeup.wait_until(lock, due);
+				continue;
+			}
+
+			std::vector<unsigned char> bytes;
+			bytes.swap(const_cast<Event&>(m_events.top()).bytes);
+			m_events.pop();
+
+			lock.unlock();
+			m_send(bytes.data(), bytes.size());
+			lock.lock();
+		}
+	}
+
+	SendCallback m_send;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wakeup;
+	std::priority_queue<Event> m_events;
+	unsigned long m_nextOrder;
+	bool m_stop;
+
+	std::thread m_thread;
+};
+
+#endif
@@ -0,0 +1,164 @@
+/********************************
+
+PortLatency.h
+
+Output port latency calibration for PlaybackModuleMIDI
+
+calibratePortLatency() measures the output-to-input round trip of a
+MIDI output port through a loopback cable or virtual port connection,
+as the median of CALIBRATION_ROUNDS probes. Results are kept per port
+name in a latency file, one "<microseconds> <port name>" per line.
+
+To make every calibrated port sound at the same time, a port's events
+are delayed by the latency of the slowest calibrated port minus its
+own (see PortLatencyTable::compensation).
+
+********************************/
+
+#ifndef NDNMIDI_PORT_LATENCY_H
+#define NDNMIDI_PORT_LATENCY_H
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RtMidi.h"
+
+// Number of probes sent to measure a port
+#define CALIBRATION_ROUNDS 20
+
+// Time to wait for a probe to come back
+#define CALIBRATION_TIMEOUT_MS 1000
+
+// Probes are note ons with velocity 1 on channel 16, quiet on a synth
+#define CALIBRATION_PROBE_STATUS 0x9F
+
+class PortLatencyTable
+{
+public:
+	bool
+	load(const std::string& path)
+	{
+		m_path = path;
+		m_latencies.clear();
+		std::ifstream in(path.c_str());
+		if (!in)
+		{
+			// Nothing calibrated yet
+			return true;
+		}
+		long latencyUs;
+		std::string portName;
+		while (in >> latencyUs && std::getline(in >> std::ws, portName))
+		{
+			m_latencies[portName] = latencyUs;
+		}
+		return in.eof();
+	}
+
+	bool
+	save()
+	{
+		std::ofstream out(m_path.c_str());
+		for (const std::pair<const std::string, long>& entry : m_latencies)
+		{
+			out << entry.second << " " << entry.first << "\n";
+		}
+		return (bool)out;
+	}
+
+	// Measured latency of portName in microseconds, or -1
+	long
+	get(const std::string& portName) const
+	{
+		std::map<std::string, long>::const_iterator it = m_latencies.find(portName);
+		return it == m_latencies.end() ? -1 : it->second;
+	}
+
+	void
+	set(const std::string& portName, long latencyUs)
+	{
+		m_latencies[portName] = latencyUs;
+	}
+
+	// Delay that aligns portName with the slowest calibrated port
+	// Uncalibrated ports are not delayed
+	long
+	compensation(const std::string& portName) const
+	{
+		long own = get(portName);
+		if (own < 0)
+		{
+			return 0;
+		}
+		long slowest = 0;
+		for (const std::pair<const std::string, long>& entry : m_latencies)
+		{
+			slowest = std::max(slowest, entry.second);
+		}
+		return slowest - own;
+	}
+
+private:
+	std::string m_path;
+	std::map<std::string, long> m_latencies;
+};
+
+// Round trip of out to in in microseconds, or -1 if probes do not come
+// back; out must be looped back to in
+template <class Output, class Input>
+long
+calibratePortLatency(Output& out, Input& in, unsigned int rounds = CALIBRATION_ROUNDS)
+{
+	std::vector<long> samples;
+	std::vector<unsigned char> message;
+
+	// Drop anything queued before the first probe
+	do
+	{
+		in.getMessage(&message);
+	} while (!message.empty());
+
+	for (unsigned int round = 0; round < rounds; ++round)
+	{
+		unsigned char note = round & 0x7F;
+		std::vector<unsigned char> probe = {CALIBRATION_PROBE_STATUS, note, 1};
+		std::chrono::steady_clock::time_point sent = std::chrono::steady_clock::now();
+		out.sendMessage(&probe);
+
+		bool received = false;
+		while (!received && std::chrono::steady_clock::now() - sent < std::chrono::milliseconds(CALIBRATION_TIMEOUT_MS))
+		{
+			in.getMessage(&message);
+			if (message.size() == 3 && message[0] == CALIBRATION_PROBE_STATUS && message[1] == note)
+			{
+				samples.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+					std::chrono::steady_clock::now() - sent).count());
+				received = true;
+			}
+			else if (message.empty())
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+			}
+		}
+
+		// Silence the probe and let the port settle
+		probe[2] = 0;
+		out.sendMessage(&probe);
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+
+	if (samples.size() < rounds / 2)
+	{
+		return -1;
+	}
+	std::sort(samples.begin(), samples.end());
+	return samples[samples.size() / 2];
+}
+
+#endif
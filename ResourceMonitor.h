@@ -0,0 +1,229 @@
+/********************************
+
+ResourceMonitor.h
+
+Resource sampling and growth detection for soak runs of midi-ndn-node
+
+Samples resident memory, CPU use and any number of gauges (pending
+Interests, queue depths) at a fixed interval. At the end of a run every
+series is checked for an upward trend: after dropping the warm-up
+samples, the least-squares slope over the run must not add more than
+SOAK_GROWTH_LIMIT of the series' mean (plus a small absolute floor, so
+near-zero series do not trip on noise), and the last quarter of the run
+must not sit above the first quarter by that much either.
+
+********************************/
+
+#ifndef NDNMIDI_RESOURCE_MONITOR_H
+#define NDNMIDI_RESOURCE_MONITOR_H
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+  #include <mach/mach.h>
+#endif
+
+// Fraction of the samples at the start of a run ignored as warm-up
+#define SOAK_WARMUP_FRACTION 0.1
+
+// Largest growth over the run allowed, relative to the series mean
+#define SOAK_GROWTH_LIMIT 0.1
+
+// Minimum number of samples after warm-up to judge a trend
+#define SOAK_MIN_SAMPLES 8
+
+class ResourceMonitor
+{
+public:
+	typedef std::function<double()> Gauge;
+
+	ResourceMonitor()
+		: m_start(std::chrono::steady_clock::now())
+		, m_lastWall(m_start)
+		, m_lastCpuS(cpuSeconds())
+	{
+		addSeries("rss_kb", 1024, residentKB);
+		addSeries("cpu_percent", 5, std::bind(&ResourceMonitor::cpuPercent, this));
+	}
+
+	// Track a gauge; floor is the growth always tolerated, in its units
+	void
+	addSeries(const std::string& name, double floor, const Gauge& gauge)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		Series series = {name, floor, gauge, std::vector<double>()};
+		m_series.push_back(series);
+	}
+
+	// Record one value of every series
+	void
+	sample()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count());
+		for (Series& series : m_series)
+		{
+			series.values.push_back(series.gauge());
+		}
+	}
+
+	// Print the latest values on one line
+	void
+	printLatest(std::ostream& out)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_times.empty())
+		{
+			return;
+		}
+		out << "[soak " << std::fixed << std::setprecision(0) << m_times.back() << "s]";
+		for (Series& series : m_series)
+		{
+			out << " " << series.name << "=" << std::setprecision(1) << series.values.back();
+		}
+		out << std::endl;
+	}
+
+	// Latest value of the series called name, or 0
+	double
+	getLatest(const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (Series& series : m_series)
+		{
+			if (series.name == name && !series.values.empty())
+			{
+				return series.values.back();
+			}
+		}
+		return 0;
+	}
+
+	// Report the trend of every series
+	// Returns false if any of them grows
+	bool
+	checkTrends(std::ostream& out)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		size_t begin = m_times.size() * SOAK_WARMUP_FRACTION;
+		size_t count = m_times.size() - begin;
+		if (count < SOAK_MIN_SAMPLES)
+		{
+			out << "Soak: too few samples (" << count << ") to judge trends" << std::endl;
+			return false;
+		}
+
+		bool stable = true;
+		for (Series& series : m_series)
+		{
+			// Least-squares slope over the run
+			double meanT = 0, meanV = 0;
+			for (size_t i = begin; i < m_times.size(); ++i)
+			{
+				meanT += m_times[i];
+				meanV += series.values[i];
+			}
+			meanT /= count;
+			meanV /= count;
+			double cov = 0, var = 0;
+			for (size_t i = begin; i < m_times.size(); ++i)
+			{
+				cov += (m_times[i] - meanT) * (series.values[i] - meanV);
+				var += (m_times[i] - meanT) * (m_times[i] - meanT);
+			}
+			double growth = var > 0 ? cov / var * (m_times.back() - m_times[begin]) : 0;
+
+			// First and last quarter
+			size_t quarter = count / 4;
+			double first = 0, last = 0;
+			for (size_t i = 0; i < quarter; ++i)
+			{
+				first += series.values[begin + i];
+				last += series.values[m_times.size() - 1 - i];
+			}
+			first /= quarter;
+			last /= quarter;
+
+			double limit = SOAK_GROWTH_LIMIT * meanV + series.floor;
+			bool grows = growth > limit && last - first > limit;
+			if (grows)
+			{
+				stable = false;
+			}
+			out << "Soak: " << std::left << std::setw(20) << series.name << std::right
+				<< std::fixed << std::setprecision(1)
+				<< " first " << first << " last " << last << " growth " << growth
+				<< " limit " << limit << (grows ? "  GROWING" : "  ok") << std::endl;
+		}
+		return stable;
+	}
+
+private:
+	struct Series
+	{
+		std::string name;
+		double floor;
+		Gauge gauge;
+		std::vector<double> values;
+	};
+
+	static double
+	residentKB()
+	{
+#if defined(__APPLE__)
+		mach_task_basic_info info;
+		mach_msg_type_number_t infoCount = MACH_TASK_BASIC_INFO_COUNT;
+		if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &infoCount) != KERN_SUCCESS)
+		{
+			return 0;
+		}
+		return info.resident_size / 1024.0;
+#else
+		std::ifstream statm("/proc/self/statm");
+		long pages = 0, residentPages = 0;
+		statm >> pages >> residentPages;
+		return residentPages * (sysconf(_SC_PAGESIZE) / 1024.0);
+#endif
+	}
+
+	static double
+	cpuSeconds()
+	{
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+			+ (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+	}
+
+	// CPU use since the previous sample, in percent of one core
+	double
+	cpuPercent()
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		double cpuS = cpuSeconds();
+		double wallS = std::chrono::duration<double>(now - m_lastWall).count();
+		double percent = wallS > 0 ? 100 * (cpuS - m_lastCpuS) / wallS : 0;
+		m_lastWall = now;
+		m_lastCpuS = cpuS;
+		return percent;
+	}
+
+	std::mutex m_mutex;
+	std::chrono::steady_clock::time_point m_start;
+	std::chrono::steady_clock::time_point m_lastWall;
+	double m_lastCpuS;
+	std::vector<double> m_times;
+	std::vector<Series> m_series;
+};
+
+#endif
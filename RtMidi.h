@@ -760,4 +760,108 @@ class MidiOutDummy: public MidiOutApi
 
 #endif
 
+// **************************************************************** //
+//
+// Statically dispatched RtMidiInT / RtMidiOutT front ends.
+//
+// When only one backend is compiled in, the runtime selection done by
+// RtMidiIn / RtMidiOut is pure overhead: every call goes through
+// rtapi_ and a virtual MidiInApi / MidiOutApi function.  The
+// templates below own the backend object directly and call it with
+// qualified (non-virtual) calls, so getMessage() and sendMessage()
+// are direct calls that can be inlined (e.g. with -flto).
+//
+// Usage: RtMidiOutT<AlsaBackend> midiout;
+//
+// **************************************************************** //
+
+#if defined(__MACOSX_CORE__)
+struct CoreBackend { typedef MidiInCore In; typedef MidiOutCore Out; };
+#endif
+#if defined(__UNIX_JACK__)
+struct JackBackend { typedef MidiInJack In; typedef MidiOutJack Out; };
+#endif
+#if defined(__LINUX_ALSA__)
+struct AlsaBackend { typedef MidiInAlsa In; typedef MidiOutAlsa Out; };
+#endif
+#if defined(__WINDOWS_MM__)
+struct WinMMBackend { typedef MidiInWinMM In; typedef MidiOutWinMM Out; };
+#endif
+#if defined(__RTMIDI_DUMMY__)
+struct DummyBackend { typedef MidiInDummy In; typedef MidiOutDummy Out; };
+#endif
+
+// RtMidiStaticBackend names the backend when exactly one is compiled in.
+#if (defined(__MACOSX_CORE__) + defined(__UNIX_JACK__) + defined(__LINUX_ALSA__) + defined(__WINDOWS_MM__)) == 1
+  #define RTMIDI_SINGLE_BACKEND
+  #if defined(__MACOSX_CORE__)
+    typedef CoreBackend RtMidiStaticBackend;
+  #elif defined(__UNIX_JACK__)
+    typedef JackBackend RtMidiStaticBackend;
+  #elif defined(__LINUX_ALSA__)
+    typedef AlsaBackend RtMidiStaticBackend;
+  #else
+    typedef WinMMBackend RtMidiStaticBackend;
+  #endif
+#endif
+
+//! Realtime MIDI input bound to a single backend at compile time.
+template <class Backend>
+class RtMidiInT
+{
+ public:
+  typedef typename Backend::In Api;
+  typedef RtMidiIn::RtMidiCallback RtMidiCallback;
+
+  RtMidiInT( const std::string clientName = std::string( "RtMidi Input Client"),
+             unsigned int queueSizeLimit = 100 )
+    : api_( clientName, queueSizeLimit ) {}
+
+  RtMidi::Api getCurrentApi( void ) throw() { return api_.Api::getCurrentApi(); }
+  void openPort( unsigned int portNumber = 0, const std::string portName = std::string( "RtMidi Input" ) ) { api_.Api::openPort( portNumber, portName ); }
+  void openVirtualPort( const std::string portName = std::string( "RtMidi Input" ) ) { api_.Api::openVirtualPort( portName ); }
+  void setCallback( RtMidiCallback callback, void *userData = 0 ) { api_.setCallback( callback, userData ); }
+  void cancelCallback() { api_.cancelCallback(); }
+  void closePort( void ) { api_.Api::closePort(); }
+  bool isPortOpen() const { return api_.isPortOpen(); }
+  unsigned int getPortCount() { return api_.Api::getPortCount(); }
+  std::string getPortName( unsigned int portNumber = 0 ) { return api_.Api::getPortName( portNumber ); }
+  void ignoreTypes( bool midiSysex = true, bool midiTime = true, bool midiSense = true ) { api_.Api::ignoreTypes( midiSysex, midiTime, midiSense ); }
+  double getMessage( std::vector<unsigned char> *message ) { return api_.getMessage( message ); }
+  void setErrorCallback( RtMidiErrorCallback errorCallback = NULL, void *userData = 0 ) { api_.setErrorCallback( errorCallback, userData ); }
+
+ private:
+  RtMidiInT( const RtMidiInT& );
+  RtMidiInT& operator=( const RtMidiInT& );
+
+  Api api_;
+};
+
+//! Realtime MIDI output bound to a single backend at compile time.
+template <class Backend>
+class RtMidiOutT
+{
+ public:
+  typedef typename Backend::Out Api;
+
+  RtMidiOutT( const std::string clientName = std::string( "RtMidi Output Client") )
+    : api_( clientName ) {}
+
+  RtMidi::Api getCurrentApi( void ) throw() { return api_.Api::getCurrentApi(); }
+  void openPort( unsigned int portNumber = 0, const std::string portName = std::string( "RtMidi Output" ) ) { api_.Api::openPort( portNumber, portName ); }
+  void openVirtualPort( const std::string portName = std::string( "RtMidi Output" ) ) { api_.Api::openVirtualPort( portName ); }
+  void closePort( void ) { api_.Api::closePort(); }
+  bool isPortOpen() const { return api_.isPortOpen(); }
+  unsigned int getPortCount() { return api_.Api::getPortCount(); }
+  std::string getPortName( unsigned int portNumber = 0 ) { return api_.Api::getPortName( portNumber ); }
+  void sendMessage( std::vector<unsigned char> *message ) { api_.Api::sendMessage( message ); }
+  void setErrorCallback( RtMidiErrorCallback errorCallback = NULL, void *userData = 0 ) { api_.setErrorCallback( errorCallback, userData ); }
+
+ private:
+  RtMidiOutT( const RtMidiOutT& );
+  RtMidiOutT& operator=( const RtMidiOutT& );
+
+  Api api_;
+};
+
 #endif
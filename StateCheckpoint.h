@@ -0,0 +1,187 @@
+/********************************
+
+StateCheckpoint.h
+
+Memory-mapped connection state for PlaybackModuleMIDI warm restarts
+
+Each MIDI channel owns one fixed-size slot holding the remote name,
+its sequence number window, the bitmap of packets received in it and
+whether the slot is in use. Updates are
+plain stores into a MAP_SHARED mapping, so they cost nothing on the hot
+path and survive a crash of the process (the kernel keeps the pages).
+The header records when the file was last touched, so a checkpoint left
+behind long ago is not resumed.
+
+********************************/
+
+#ifndef NDNMIDI_STATE_CHECKPOINT_H
+#define NDNMIDI_STATE_CHECKPOINT_H
+
+#include <iostream>
+#include <string>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CHECKPOINT_MAGIC 0x4E4D4350	// "NMCP"
+#define CHECKPOINT_VERSION 2
+#define CHECKPOINT_SLOTS 16
+#define CHECKPOINT_NAME_SIZE 64
+
+// Largest sequence number window a slot may be resumed with
+#define CHECKPOINT_MAX_WINDOW 1024
+
+struct CheckpointSlot
+{
+	char remoteName[CHECKPOINT_NAME_SIZE];
+	int32_t minSeqNo;
+	int32_t maxSeqNo;
+	int32_t inUse;
+	int32_t reserved;
+	uint64_t received;	// bit i set once minSeqNo + i has arrived
+};
+
+struct CheckpointFile
+{
+	uint32_t magic;
+	uint32_t version;
+	int64_t updatedAt;	// wall clock seconds
+	CheckpointSlot slot[CHECKPOINT_SLOTS];
+};
+
+class StateCheckpoint
+{
+public:
+	StateCheckpoint()
+		: m_fd(-1)
+		, m_file(NULL)
+	{
+	}
+
+	~StateCheckpoint()
+	{
+		if (m_file)
+		{
+			munmap(m_file, sizeof(CheckpointFile));
+		}
+		if (m_fd >= 0)
+		{
+			close(m_fd);
+		}
+	}
+
+	// Map path, creating it if needed
+	// An unrecognised file is reset
+	bool
+	open(const std::string& path)
+	{
+		m_fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		if (m_fd < 0 || ftruncate(m_fd, sizeof(CheckpointFile)) != 0)
+		{
+			std::cerr << "Could not open state file: " << path << std::endl;
+			return false;
+		}
+
+		void *mapped = mmap(NULL, sizeof(CheckpointFile), PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+		if (mapped == MAP_FAILED)
+		{
+			std::cerr << "Could not map state file: " << path << std::endl;
+			return false;
+		}
+		m_file = static_cast<CheckpointFile*>(mapped);
+
+		if (m_file->magic != CHECKPOINT_MAGIC || m_file->version != CHECKPOINT_VERSION)
+		{
+			memset(m_file, 0, sizeof(CheckpointFile));
+			m_file->magic = CHECKPOINT_MAGIC;
+			m_file->version = CHECKPOINT_VERSION;
+		}
+		return true;
+	}
+
+	bool
+	isOpen() const
+	{
+		return m_file != NULL;
+	}
+
+	// Seconds since the checkpoint was last touched
+	int64_t
+	age() const
+	{
+		return m_file ? time(NULL) - m_file->updatedAt : 0;
+	}
+
+	const CheckpointSlot&
+	get(int channel) const
+	{
+		return m_file->slot[channel];
+	}
+
+	// Record a new connection on channel
+	// Names that do not fit a slot are not recorded: truncated, they
+	// would resume a connection no controller matches
+	void
+	open(int channel, const std::string& remoteName, int minSeqNo, int maxSeqNo)
+	{
+		if (!m_file)
+		{
+			return;
+		}
+		CheckpointSlot& slot = m_file->slot[channel];
+		if (remoteName.size() >= CHECKPOINT_NAME_SIZE)
+		{
+			std::cerr << "Not checkpointing " << remoteName << ": name longer than "
+					  << CHECKPOINT_NAME_SIZE - 1 << " characters" << std::endl;
+			slot.inUse = 0;
+			return;
+		}
+		strncpy(slot.remoteName, remoteName.c_str(), CHECKPOINT_NAME_SIZE - 1);
+		slot.remoteName[CHECKPOINT_NAME_SIZE - 1] = '\0';
+		slot.minSeqNo = minSeqNo;
+		slot.maxSeqNo = maxSeqNo;
+		slot.received = 0;
+		slot.inUse = 1;
+	}
+
+	// Record the current sequence number window of channel
+	void
+	update(int channel, int minSeqNo, int maxSeqNo, uint64_t received)
+	{
+		if (m_file)
+		{
+			m_file->slot[channel].minSeqNo = minSeqNo;
+			m_file->slot[channel].maxSeqNo = maxSeqNo;
+			m_file->slot[channel].received = received;
+		}
+	}
+
+	void
+	remove(int channel)
+	{
+		if (m_file)
+		{
+			m_file->slot[channel].inUse = 0;
+		}
+	}
+
+	// Mark the checkpoint as current
+	void
+	touch()
+	{
+		if (m_file)
+		{
+			m_file->updatedAt = time(NULL);
+		}
+	}
+
+private:
+	int m_fd;
+	CheckpointFile *m_file;
+};
+
+#endif
@@ -0,0 +1,214 @@
+/********************************
+
+StateVectorSync.h
+
+State-vector sync for group sessions of midi-ndn-node
+
+Every participant publishes one sequence-numbered stream under its own
+prefix. Participants learn each other's latest sequence numbers by
+exchanging sync Interests under /midi-ndn/<proj>/sync, whose name
+carries the sender's whole state vector as <name>/<seq> pairs:
+
+  /midi-ndn/<proj>/sync/alice/%0C/bob/%2A
+
+A sync Interest is sent every SYNC_PERIOD_MS, right after a local
+publish, and soon after hearing a vector that is missing newer state,
+so each participant sends O(1) sync Interests per period regardless of
+group size. Sync Interests are never answered with Data. The sync
+prefix needs the multicast strategy in NFD:
+
+  nfdc strategy set /midi-ndn/<proj>/sync /localhost/nfd/strategy/multicast
+
+********************************/
+
+#ifndef NDNMIDI_STATE_VECTOR_SYNC_H
+#define NDNMIDI_STATE_VECTOR_SYNC_H
+
+#include <ndn-cxx/face.hpp>
+#include <ndn-cxx/interest.hpp>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Interval between periodic sync Interests
+#define SYNC_PERIOD_MS 1000
+
+// Minimum interval between triggered sync Interests
+#define SYNC_MIN_INTERVAL_MS 50
+
+class StateVectorSync
+{
+public:
+	// Called with a participant's name and its latest sequence number,
+	// every time a sync Interest from that participant is heard
+	typedef std::function<void(const std::string&, uint64_t)> UpdateCallback;
+
+	StateVectorSync(ndn::Face& face, const std::string& nodeName, const std::string& projName,
+					const UpdateCallback& onUpdate)
+		: m_face(face)
+		, m_syncPrefix(ndn::Name("/midi-ndn/" + projName + "/sync"))
+		, m_nodeName(nodeName)
+		, m_onUpdate(onUpdate)
+		, m_sendSoon(true)
+		, m_published(false)
+	{
+		m_face.setInterestFilter(m_syncPrefix,
+								 std::bind(&StateVectorSync::onSyncInterest, this, _2),
+								 [this] (const ndn::Name& prefix) {
+									 std::cerr << "Sync prefix registered" << std::endl;
+									 m_thread = std::thread(&StateVectorSync::run, this);
+								 },
+								 [] (const ndn::Name& prefix, const std::string& reason) {
+									 std::cerr << "Failed to register sync prefix: " << reason << std::endl;
+								 });
+	}
+
+	// Record a new local sequence number and announce it
+	void
+	publish(uint64_t seqNo)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_published || seqNo > m_vector[m_nodeName])
+		{
+			m_vector[m_nodeName] = seqNo;
+			m_published = true;
+			m_sendSoon = true;
+		}
+	}
+
+	// Number of other participants in the vector
+	size_t
+	getPeerCount()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_vector.size() - (m_published ? 1 : 0);
+	}
+
+private:
+	void
+	onSyncInterest(const ndn::Interest& interest)
+	{
+		const ndn::Name& name = interest.getName();
+		std::map<std::string, uint64_t> heard;
+		std::string sender;
+		for (size_t i = m_syncPrefix.size(); i + 1 < name.size(); i += 2)
+		{
+			if (!name.get(i + 1).isNumber())
+			{
+				return;
+			}
+			std::string member = name.get(i).toUri();
+			heard[member] = name.get(i + 1).toNumber();
+			if (sender.empty())
+			{
+				sender = member;
+			}
+		}
+		if (sender.empty() || sender == m_nodeName)
+		{
+			return;
+		}
+
+		std::map<std::string, uint64_t> updates;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (const std::pair<const std::string, uint64_t>& entry : heard)
+			{
+				if (entry.first == m_nodeName)
+				{
+					continue;
+				}
+				std::map<std::string, uint64_t>::iterator known = m_vector.find(entry.first);
+				if (known == m_vector.end() || entry.second > known->second)
+				{
+					m_vector[entry.first] = entry.second;
+				}
+			}
+			// The sender is alive whether or not its stream moved
+			updates[sender] = m_vector[sender];
+
+			// Answer soon if the sender is missing newer state
+			for (const std::pair<const std::string, uint64_t>& entry : m_vector)
+			{
+				std::map<std::string, uint64_t>::iterator theirs = heard.find(entry.first);
+				if (theirs == heard.end() || theirs->second < entry.second)
+				{
+					m_sendSoon = true;
+					break;
+				}
+			}
+		}
+
+		for (const std::pair<const std::string, uint64_t>& entry : updates)
+		{
+			m_onUpdate(entry.first, entry.second);
+		}
+	}
+
+	// Express a sync Interest carrying the whole vector, own entry first
+	void
+	sendSyncInterest()
+	{
+		ndn::Name syncName(m_syncPrefix);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			syncName.append(m_nodeName).appendNumber(m_published ? m_vector[m_nodeName] : 0);
+			for (const std::pair<const std::string, uint64_t>& entry : m_vector)
+			{
+				if (entry.first != m_nodeName)
+				{
+					syncName.append(entry.first).appendNumber(entry.second);
+				}
+			}
+			m_sendSoon = false;
+		}
+
+		ndn::Interest syncInterest(syncName);
+		syncInterest.setInterestLifetime(ndn::time::milliseconds(SYNC_PERIOD_MS));
+		syncInterest.setMustBeFresh(true);
+		m_face.expressInterest(syncInterest,
+							   [] (const ndn::Interest&, const ndn::Data&) {},
+							   [] (const ndn::Interest&, const ndn::lp::Nack&) {},
+							   [] (const ndn::Interest&) {});
+	}
+
+	void
+	run()
+	{
+		std::chrono::steady_clock::time_point lastSent;
+		while (true)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(SYNC_MIN_INTERVAL_MS));
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			bool sendSoon;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				sendSoon = m_sendSoon;
+			}
+			if (sendSoon || now - lastSent >= std::chrono::milliseconds(SYNC_PERIOD_MS))
+			{
+				sendSyncInterest();
+				lastSent = now;
+			}
+		}
+	}
+
+	ndn::Face& m_face;
+	ndn::Name m_syncPrefix;
+	std::string m_nodeName;
+	UpdateCallback m_onUpdate;
+
+	std::mutex m_mutex;
+	std::map<std::string, uint64_t> m_vector;
+	bool m_sendSoon;
+	bool m_published;
+
+	std::thread m_thread;
+};
+
+#endif
@@ -0,0 +1,55 @@
+/********************************
+
+StreamNames.h
+
+Short data names for NDN-MIDI streams
+
+A controller picks a random stream id and proposes it in its heartbeat
+Interests (<dev>/heartbeat/<id>). A playback module that accepts it
+echoes the id at the end of its handshake reply. From then on it fetches
+/m/<id>/<seqNo> instead of /topo-prefix/<dev>/midi-ndn/<proj>/<seqNo>,
+which makes every Interest and Data packet smaller and every PIT and CS
+lookup on the path cheaper. The controller registers /m/<id>, so the
+short prefix is routed the same way as its full one. A module that
+refuses the id (it collides with another stream) replies with id 0 and
+keeps fetching full names. The controller answers both.
+
+********************************/
+
+#ifndef NDNMIDI_STREAM_NAMES_H
+#define NDNMIDI_STREAM_NAMES_H
+
+#include <ndn-cxx/name.hpp>
+
+#include <stdlib.h>
+
+// Prefix of short data names
+#define SHORT_STREAM_PREFIX "/m"
+
+// Prefix of the short data names of stream id
+inline ndn::Name
+shortStreamPrefix(uint64_t id)
+{
+	return ndn::Name(SHORT_STREAM_PREFIX).appendNumber(id);
+}
+
+// Whether name is a short data name, /m/<id>[/<ack>]/<seqNo>
+inline bool
+isShortStreamName(const ndn::Name& name)
+{
+	return (name.size() == 3 || name.size() == 4) && name.get(0).toUri() == "m";
+}
+
+// A random stream id, never 0; four bytes on the wire
+inline uint64_t
+newStreamId()
+{
+	uint64_t id = 0;
+	while (id == 0)
+	{
+		id = ((uint64_t)(rand() & 0xFFFF) << 16) | (rand() & 0xFFFF);
+	}
+	return id;
+}
+
+#endif
@@ -0,0 +1,76 @@
+/********************************
+
+Tracepoints.h
+
+USDT (SystemTap/DTrace style) probes on the hot stages of NDN-MIDI
+
+Each stage of an event's trip fires a probe of the "ndnmidi" provider:
+
+  capture         (now_us, bytes, status)          midiLoopNoBlock
+  add_input       (capture_us, ump_word, queued)   Controller::addInput
+  reply_interest  (seq, messages, bytes)           Controller::replyInterest
+  send_data       (seq, bytes, now_us)             Controller::sendData
+  interest        (seq, next_seq, now_us)          Controller::onInterest
+  control         (kind, remote, now_us)           PlaybackModule::onInterest
+  data            (seq, bytes, now_us, path)       PlaybackModule::onData
+  request_next    (seq, stream_id, now_us)         PlaybackModule::requestNext
+  send_message    (status, bytes, now_us)          output port
+
+Times are umpClockMicros(), the clock of JR timestamps, so stages of the
+controller and the playback module line up on one host. kind and remote
+are C strings.
+
+A probe is a single nop until a tracer attaches. Its semaphore is then
+set, and only then are the arguments computed, so the probes cost a load
+and a branch in production builds. They are compiled in when
+<sys/sdt.h> is found (systemtap-sdt-dev) unless NDNMIDI_NO_USDT is
+defined, and compile to nothing otherwise.
+
+List them with `bpftrace -l 'usdt:./midi-ndn-node:ndnmidi:*'`.
+
+********************************/
+
+#ifndef NDNMIDI_TRACEPOINTS_H
+#define NDNMIDI_TRACEPOINTS_H
+
+#if !defined(NDNMIDI_NO_USDT) && defined(__has_include)
+  #if __has_include(<sys/sdt.h>)
+    #define NDNMIDI_USDT 1
+  #endif
+#endif
+
+#ifdef NDNMIDI_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+// Set by the kernel while a tracer is attached to the probe
+#define NDNMIDI_PROBE_SEMAPHORE(name) \
+	__extension__ static volatile unsigned short ndnmidi_##name##_semaphore \
+	__attribute__((used, section(".probes")))
+
+#define NDNMIDI_PROBE_ENABLED(name) __builtin_expect(ndnmidi_##name##_semaphore != 0, 0)
+
+#define NDNMIDI_TRACE3(name, a, b, c) \
+	do { if (NDNMIDI_PROBE_ENABLED(name)) DTRACE_PROBE3(ndnmidi, name, a, b, c); } while (0)
+#define NDNMIDI_TRACE4(name, a, b, c, d) \
+	do { if (NDNMIDI_PROBE_ENABLED(name)) DTRACE_PROBE4(ndnmidi, name, a, b, c, d); } while (0)
+
+NDNMIDI_PROBE_SEMAPHORE(capture);
+NDNMIDI_PROBE_SEMAPHORE(add_input);
+NDNMIDI_PROBE_SEMAPHORE(reply_interest);
+NDNMIDI_PROBE_SEMAPHORE(send_data);
+NDNMIDI_PROBE_SEMAPHORE(interest);
+NDNMIDI_PROBE_SEMAPHORE(control);
+NDNMIDI_PROBE_SEMAPHORE(data);
+NDNMIDI_PROBE_SEMAPHORE(request_next);
+NDNMIDI_PROBE_SEMAPHORE(send_message);
+
+#else
+
+#define NDNMIDI_TRACE3(name, a, b, c) do {} while (0)
+#define NDNMIDI_TRACE4(name, a, b, c, d) do {} while (0)
+
+#endif
+
+#endif
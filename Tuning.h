@@ -0,0 +1,139 @@
+/********************************
+
+Tuning.h
+
+Runtime values of the constants that trade latency against overhead
+
+The defaults below suit a LAN studio. A tuning file changes them for a
+deployment: one "<key> <value>" per line, '#' starts a comment, and
+missing keys keep their defaults. The jam node's --autotune mode
+measures the pipeline and writes one (see JamNodeMIDI.cpp).
+
+********************************/
+
+#ifndef NDNMIDI_TUNING_H
+#define NDNMIDI_TUNING_H
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Maximum number of MIDI messages sent in one packet
+#define MAX_PACKET_MESSAGES 10
+
+// Upper bound of the tuned packet size, within MAX_PACKET_SIZE bytes
+#define TUNING_MAX_PACKET_MESSAGES 48
+
+// Define number of interests sent once connection is made with ControllerMIDI
+#define PREWARM_AMOUNT 5
+
+// Length in seconds between heartbeat probes
+#define HEARTBEAT_PERIOD_S 5
+
+// Define maximum time for connection with ControllerMIDI to be inactive
+#define MAX_INACTIVE_TIME 5
+
+// Lifetime in seconds of data Interests
+#define INTEREST_LIFETIME_S 3600
+
+// Messages the MIDI input port buffers until they are read
+#define MIDI_INPUT_QUEUE_SIZE 100
+
+// Microseconds an event may wait in the controller for others to share
+// its packet; 0 sends whenever an Interest is waiting
+#define BATCH_DEADLINE_US 0
+
+struct Tuning
+{
+	unsigned int packetMessages;
+	unsigned int prewarm;
+	unsigned int heartbeatPeriodS;
+	unsigned int maxInactiveS;
+	unsigned int interestLifetimeS;
+	unsigned int inputQueueSize;
+	unsigned int batchDeadlineUs;
+
+	Tuning()
+		: packetMessages(MAX_PACKET_MESSAGES)
+		, prewarm(PREWARM_AMOUNT)
+		, heartbeatPeriodS(HEARTBEAT_PERIOD_S)
+		, maxInactiveS(MAX_INACTIVE_TIME)
+		, interestLifetimeS(INTEREST_LIFETIME_S)
+		, inputQueueSize(MIDI_INPUT_QUEUE_SIZE)
+		, batchDeadlineUs(BATCH_DEADLINE_US)
+	{
+	}
+
+	bool
+	loadFile(const std::string& fileName)
+	{
+		std::ifstream file(fileName);
+		if (!file)
+		{
+			std::cerr << "Could not open tuning file: " << fileName << std::endl;
+			return false;
+		}
+
+		Tuning tuning;
+		std::string line;
+		int lineNo = 0;
+		while (std::getline(file, line))
+		{
+			++lineNo;
+			std::istringstream words(line);
+			std::string key;
+			if (!(words >> key) || key[0] == '#')
+			{
+				continue;
+			}
+			unsigned int *field = tuning.find(key);
+			long value;
+			if (field == NULL || !(words >> value) || value < 1)
+			{
+				std::cerr << fileName << ":" << lineNo
+						  << ": expected \"<setting> <positive number>\"" << std::endl;
+				return false;
+			}
+			*field = value;
+		}
+		if (tuning.packetMessages > TUNING_MAX_PACKET_MESSAGES)
+		{
+			std::cerr << fileName << ": packet-messages is at most " << TUNING_MAX_PACKET_MESSAGES << std::endl;
+			return false;
+		}
+		*this = tuning;
+		return true;
+	}
+
+	void
+	write(std::ostream& out) const
+	{
+		out << "packet-messages " << packetMessages << "\n"
+			<< "prewarm " << prewarm << "\n"
+			<< "heartbeat-period-s " << heartbeatPeriodS << "\n"
+			<< "max-inactive-s " << maxInactiveS << "\n"
+			<< "interest-lifetime-s " << interestLifetimeS << "\n"
+			<< "input-queue-size " << inputQueueSize << "\n";
+		if (batchDeadlineUs > 0)
+		{
+			out << "batch-deadline-us " << batchDeadlineUs << "\n";
+		}
+	}
+
+private:
+	unsigned int*
+	find(const std::string& key)
+	{
+		if (key == "packet-messages") return &packetMessages;
+		if (key == "prewarm") return &prewarm;
+		if (key == "heartbeat-period-s") return &heartbeatPeriodS;
+		if (key == "max-inactive-s") return &maxInactiveS;
+		if (key == "interest-lifetime-s") return &interestLifetimeS;
+		if (key == "input-queue-size") return &inputQueueSize;
+		if (key == "batch-deadline-us") return &batchDeadlineUs;
+		return NULL;
+	}
+};
+
+#endif
@@ -0,0 +1,309 @@
+/********************************
+
+UniversalMidiPacket.h
+
+MIDI 2.0 Universal MIDI Packet (UMP) event representation shared by
+ControllerMIDI and PlaybackModuleMIDI
+
+Events are carried internally and on the wire as 32-bit UMP words.
+MIDI 1.0 byte messages are only used at the RtMidi edges:
+midi1ToUMP() on capture and umpToMIDI1() on playback.
+On the wire every word is stored big-endian, as in the UMP spec.
+
+An all-zero word (UMP utility NOOP) replaces the old 0,0,0 MIDI 1.0
+message as the connection shutdown marker.
+
+Every event is preceded by a utility JR Timestamp word holding the low
+16 bits of its capture time in 32 us ticks, in the clock of the
+playback module (see ControllerMIDI.h). Receivers without timestamp
+support skip these words as messages without a MIDI 1.0 equivalent.
+
+Sequenced events sent ahead of time (lookahead) also carry a Play-At
+word after their timestamp, a private utility status holding how long
+after the timestamp the event is to be played. JR Timestamps alone wrap
+too soon to date events seconds ahead.
+
+********************************/
+
+#ifndef NDNMIDI_UNIVERSAL_MIDI_PACKET_H
+#define NDNMIDI_UNIVERSAL_MIDI_PACKET_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <chrono>
+
+// UMP message types (upper nibble of the first word)
+#define UMP_TYPE_UTILITY 0x0
+#define UMP_TYPE_SYSTEM 0x1
+#define UMP_TYPE_MIDI1_VOICE 0x2
+#define UMP_TYPE_DATA64 0x3
+#define UMP_TYPE_MIDI2_VOICE 0x4
+
+// Largest UMP message in 32-bit words
+#define UMP_MAX_WORDS 4
+
+// Special word used to close a connection
+#define UMP_SHUTDOWN 0x00000000u
+
+// Utility message status of a JR Timestamp and its tick length
+#define UMP_UTILITY_JR_TIMESTAMP 0x2
+#define UMP_JR_TICK_US 32
+
+// Span of a JR Timestamp before it wraps around (2.097 s)
+#define UMP_JR_PERIOD_US (65536ull * UMP_JR_TICK_US)
+
+// Utility message status of a Play-At word, unused by the UMP spec, and
+// the longest lead it holds in 20 bits of JR ticks (33.5 s)
+#define UMP_UTILITY_PLAY_AT 0xF
+#define UMP_PLAY_AT_MAX_US ((1ull << 20) * UMP_JR_TICK_US - 1)
+
+// Container for a single UMP message, fixed size and 32-bit aligned
+struct UMPMessage
+{
+	uint32_t word[UMP_MAX_WORDS];
+};
+
+inline unsigned int
+umpType(uint32_t word)
+{
+	return word >> 28;
+}
+
+// Number of 32-bit words in the message starting with word
+inline unsigned int
+umpWordCount(uint32_t word)
+{
+	static const unsigned char sizes[16] = {1, 1, 1, 2, 2, 4, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4};
+	return sizes[umpType(word)];
+}
+
+// Status byte of a system or channel voice message
+inline unsigned int
+umpStatus(uint32_t word)
+{
+	return (word >> 16) & 0xFF;
+}
+
+inline bool
+umpHasChannel(uint32_t word)
+{
+	unsigned int type = umpType(word);
+	return type == UMP_TYPE_MIDI1_VOICE || type == UMP_TYPE_MIDI2_VOICE;
+}
+
+inline unsigned int
+umpChannel(uint32_t word)
+{
+	return (word >> 16) & 0x0F;
+}
+
+// Wall clock time in microseconds, the time base of JR Timestamps
+inline uint64_t
+umpClockMicros()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// JR Timestamp word for a time in microseconds
+inline uint32_t
+umpJRTimestamp(uint64_t timeUs)
+{
+	return (UMP_TYPE_UTILITY << 28) | (UMP_UTILITY_JR_TIMESTAMP << 20)
+		| (uint32_t)((timeUs / UMP_JR_TICK_US) & 0xFFFF);
+}
+
+inline bool
+umpIsJRTimestamp(uint32_t word)
+{
+	return umpType(word) == UMP_TYPE_UTILITY && ((word >> 20) & 0x0F) == UMP_UTILITY_JR_TIMESTAMP;
+}
+
+// Full time in microseconds of a JR Timestamp, taken as the most recent
+// time before nowUs that matches the timestamp's ticks
+// Timestamps up to 1/8 period ahead of nowUs (clock offset error) are
+// clamped to nowUs, events older than 7/8 period alias to recent ones
+inline uint64_t
+umpJRTimestampTime(uint32_t word, uint64_t nowUs)
+{
+	uint64_t nowTicks = nowUs / UMP_JR_TICK_US;
+	uint64_t ageTicks = (nowTicks - (word & 0xFFFF)) & 0xFFFF;
+	if (ageTicks >= 0xE000 || ageTicks > nowTicks)
+	{
+		return nowUs;
+	}
+	return (nowTicks - ageTicks) * UMP_JR_TICK_US;
+}
+
+// Play-At word for an event to be played leadUs after its JR Timestamp
+inline uint32_t
+umpPlayAt(uint64_t leadUs)
+{
+	if (leadUs > UMP_PLAY_AT_MAX_US)
+	{
+		leadUs = UMP_PLAY_AT_MAX_US;
+	}
+	return (UMP_TYPE_UTILITY << 28) | (UMP_UTILITY_PLAY_AT << 20) | (uint32_t)(leadUs / UMP_JR_TICK_US);
+}
+
+inline bool
+umpIsPlayAt(uint32_t word)
+{
+	return umpType(word) == UMP_TYPE_UTILITY && ((word >> 20) & 0x0F) == UMP_UTILITY_PLAY_AT;
+}
+
+inline uint64_t
+umpPlayAtLeadUs(uint32_t word)
+{
+	return (uint64_t)(word & 0xFFFFF) * UMP_JR_TICK_US;
+}
+
+// Replace the channel of a channel voice message
+inline uint32_t
+umpSetChannel(uint32_t word, unsigned int channel)
+{
+	return umpHasChannel(word) ? (word & 0xFFF0FFFFu) | ((channel & 0x0F) << 16) : word;
+}
+
+inline void
+umpWrite(uint32_t word, uint8_t *out)
+{
+	out[0] = word >> 24;
+	out[1] = word >> 16;
+	out[2] = word >> 8;
+	out[3] = word;
+}
+
+inline uint32_t
+umpRead(const uint8_t *in)
+{
+	return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+// Number of data bytes following a MIDI 1.0 status byte
+// Returns -1 for system exclusive, which is not carried
+inline int
+midi1DataLength(unsigned char status)
+{
+	switch (status & 0xF0)
+	{
+		case 0xC0:
+		case 0xD0:
+			return 1;
+		case 0xF0:
+			break;
+		default:
+			return 2;
+	}
+	switch (status)
+	{
+		case 0xF1:
+		case 0xF3:
+			return 1;
+		case 0xF2:
+			return 2;
+		case 0xF0:
+		case 0xF7:
+			return -1;
+		default:
+			return 0;
+	}
+}
+
+// Translate one MIDI 1.0 message to a single-word UMP message
+// Returns false if the message cannot be carried (sysex, malformed)
+inline bool
+midi1ToUMP(const unsigned char *bytes, size_t size, unsigned int group, UMPMessage& out)
+{
+	if (size == 0 || !(bytes[0] & 0x80))
+	{
+		return false;
+	}
+	int dataLength = midi1DataLength(bytes[0]);
+	if (dataLength < 0 || size < (size_t)dataLength + 1)
+	{
+		return false;
+	}
+
+	uint32_t type = bytes[0] >= 0xF0 ? UMP_TYPE_SYSTEM : UMP_TYPE_MIDI1_VOICE;
+	uint32_t word = (type << 28) | ((group & 0x0F) << 24) | ((uint32_t)bytes[0] << 16);
+	if (dataLength > 0)
+	{
+		word |= (uint32_t)(bytes[1] & 0x7F) << 8;
+	}
+	if (dataLength > 1)
+	{
+		word |= bytes[2] & 0x7F;
+	}
+	out.word[0] = word;
+	return true;
+}
+
+// Translate a UMP message to MIDI 1.0 bytes
+// MIDI 2.0 channel voice messages are scaled down to 7/14 bits
+// Returns the number of bytes written to out (at most 3), or 0 if the
+// message has no MIDI 1.0 equivalent
+inline size_t
+umpToMIDI1(const uint32_t *words, unsigned char *out)
+{
+	uint32_t word = words[0];
+	unsigned char status = umpStatus(word);
+
+	switch (umpType(word))
+	{
+		case UMP_TYPE_SYSTEM:
+		case UMP_TYPE_MIDI1_VOICE:
+		{
+			int dataLength = midi1DataLength(status);
+			if (!(status & 0x80) || dataLength < 0)
+			{
+				return 0;
+			}
+			out[0] = status;
+			out[1] = (word >> 8) & 0x7F;
+			out[2] = word & 0x7F;
+			return dataLength + 1;
+		}
+		case UMP_TYPE_MIDI2_VOICE:
+		{
+			uint32_t data = words[1];
+			out[0] = status;
+			switch (status & 0xF0)
+			{
+				case 0x80:
+				case 0x90:
+					out[1] = (word >> 8) & 0x7F;
+					out[2] = data >> 25;
+					// A MIDI 2.0 note on never has zero velocity
+					if ((status & 0xF0) == 0x90 && out[2] == 0)
+					{
+						out[2] = 1;
+					}
+					return 3;
+				case 0xA0:
+				case 0xB0:
+					out[1] = (word >> 8) & 0x7F;
+					out[2] = data >> 25;
+					return 3;
+				case 0xC0:
+					out[1] = (data >> 24) & 0x7F;
+					return 2;
+				case 0xD0:
+					out[1] = data >> 25;
+					return 2;
+				case 0xE0:
+					out[1] = (data >> 18) & 0x7F;
+					out[2] = data >> 25;
+					return 3;
+				default:
+					// Per-note and registered/assignable controllers
+					return 0;
+			}
+		}
+		default:
+			return 0;
+	}
+}
+
+#endif
@@ -0,0 +1,251 @@
+/********************************
+
+WaitStrategy.h
+
+How a pipeline thread waits for work
+
+WAIT_SPIN polls without ever giving up its core: the lowest wake-up
+latency, at the price of a whole core, for dedicated isolated cores.
+WAIT_SPIN_PARK polls for WAIT_SPIN_NS and then parks until notified,
+so bursts are caught while spinning and idle time costs nothing. It is
+the default. WAIT_BLOCK parks at once, for laptops and shared machines.
+
+A producer calls notify() after queuing work. A consumer takes a ticket
+with prepare() before it looks for work and passes it to wait(), so a
+notify() in between is never lost. A thread that polls a source nobody
+notifies, like a MIDI input port, calls idle() after each empty poll
+instead, and parking becomes sleeping until the next poll.
+
+Parking uses a futex on Linux and a condition variable elsewhere.
+Wake-ups by notify() are timed from the notify() (in nanoseconds) for
+the jam node's --bench-wait mode.
+
+********************************/
+
+#ifndef NDNMIDI_WAIT_STRATEGY_H
+#define NDNMIDI_WAIT_STRATEGY_H
+
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+
+#include <stdint.h>
+
+#if defined(__linux__)
+  #include <linux/futex.h>
+  #include <sys/syscall.h>
+  #include <climits>
+  #include <time.h>
+  #include <unistd.h>
+#endif
+
+// Nanoseconds WAIT_SPIN_PARK spins before parking
+#define WAIT_SPIN_NS 50000
+
+// Longest park without a notify(), so state changes nobody signals
+// (e.g. a lost connection) are still noticed
+#define WAIT_PARK_MS 100
+
+enum WaitMode
+{
+	WAIT_SPIN,
+	WAIT_SPIN_PARK,
+	WAIT_BLOCK
+};
+
+// Parse "spin", "spin-park" or "block"
+inline bool
+parseWaitMode(const std::string& name, WaitMode& mode)
+{
+	if (name == "spin") mode = WAIT_SPIN;
+	else if (name == "spin-park") mode = WAIT_SPIN_PARK;
+	else if (name == "block") mode = WAIT_BLOCK;
+	else return false;
+	return true;
+}
+
+inline const char*
+waitModeName(WaitMode mode)
+{
+	switch (mode)
+	{
+		case WAIT_SPIN: return "spin";
+		case WAIT_SPIN_PARK: return "spin-park";
+		default: return "block";
+	}
+}
+
+class WaitStrategy
+{
+public:
+	explicit WaitStrategy(WaitMode mode = WAIT_SPIN_PARK)
+		: m_mode(mode)
+		, m_epoch(0)
+		, m_parked(0)
+		, m_notifiedNs(0)
+	{
+	}
+
+	// Takes effect at the next wait()
+	void
+	setMode(WaitMode mode)
+	{
+		m_mode = mode;
+	}
+
+	WaitMode
+	getMode() const
+	{
+		return m_mode;
+	}
+
+	// Ticket to pass to wait(), taken before looking for work
+	uint32_t
+	prepare() const
+	{
+		return m_epoch.load();
+	}
+
+	// Wake the waiting thread; a system call only if it is parked
+	void
+	notify()
+	{
+		m_notifiedNs.store(nowNs(), std::memory_order_relaxed);
+		m_epoch.fetch_add(1);
+		if (m_parked.load() > 0)
+		{
+			wake();
+		}
+	}
+
+	// Wait until notify() is called after ticket was taken, or for
+	// timeoutUs (WAIT_PARK_MS if 0); returns whether it was notified
+	bool
+	wait(uint32_t ticket, unsigned int timeoutUs = 0)
+	{
+		uint64_t now = nowNs();
+		uint64_t deadline = now + (timeoutUs > 0 ? timeoutUs * 1000ull : WAIT_PARK_MS * 1000000ull);
+		WaitMode mode = m_mode;
+		uint64_t spinUntil = mode == WAIT_SPIN ? deadline
+						   : mode == WAIT_SPIN_PARK ? std::min(deadline, now + WAIT_SPIN_NS)
+						   : now;
+		bool waited = false;
+		while (m_epoch.load() == ticket)
+		{
+			if (now >= deadline)
+			{
+				return false;
+			}
+			if (now < spinUntil)
+			{
+				cpuRelax();
+			}
+			else
+			{
+				park(ticket, deadline - now);
+			}
+			waited = true;
+			now = nowNs();
+		}
+		if (waited)
+		{
+			uint64_t notifiedNs = m_notifiedNs.load(std::memory_order_relaxed);
+			if (notifiedNs > 0 && now >= notifiedNs)
+			{
+				m_wakeLatency.record(now - notifiedNs);
+			}
+		}
+		return true;
+	}
+
+	// Pause a polling thread after an empty poll, idleNs after its last
+	// hit; the next poll is at most pollUs away
+	void
+	idle(uint64_t idleNs, unsigned int pollUs)
+	{
+		WaitMode mode = m_mode;
+		if (mode == WAIT_SPIN || (mode == WAIT_SPIN_PARK && idleNs < WAIT_SPIN_NS))
+		{
+			cpuRelax();
+			return;
+		}
+		park(prepare(), pollUs * 1000ull);
+	}
+
+	// Time from notify() to the waiter running again, in nanoseconds
+	LatencyHistogram&
+	getWakeLatency()
+	{
+		return m_wakeLatency;
+	}
+
+	static uint64_t
+	nowNs()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+private:
+	static void
+	cpuRelax()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__)
+		asm volatile("yield");
+#endif
+	}
+
+	// Sleep until woken or timeoutNs, unless the epoch already moved
+	void
+	park(uint32_t ticket, uint64_t timeoutNs)
+	{
+#if defined(__linux__)
+		m_parked.fetch_add(1);
+		if (m_epoch.load() == ticket)
+		{
+			struct timespec timeout = {(time_t)(timeoutNs / 1000000000), (long)(timeoutNs % 1000000000)};
+			syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_epoch), FUTEX_WAIT_PRIVATE, ticket, &timeout, NULL, 0);
+		}
+		m_parked.fetch_sub(1);
+#else
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_parked.fetch_add(1);
+		m_wakeup.wait_for(lock, std::chrono::nanoseconds(timeoutNs), [this, ticket] {
+			return m_epoch.load() != ticket;
+		});
+		m_parked.fetch_sub(1);
+#endif
+	}
+
+	void
+	wake()
+	{
+#if defined(__linux__)
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_epoch), FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_wakeup.notify_all();
+#endif
+	}
+
+	std::atomic<WaitMode> m_mode;
+
+	// Bumped by every notify(), and the futex word
+	std::atomic<uint32_t> m_epoch;
+	std::atomic<int> m_parked;
+	std::atomic<uint64_t> m_notifiedNs;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wakeup;
+
+	LatencyHistogram m_wakeLatency;
+};
+
+#endif